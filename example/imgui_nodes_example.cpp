@@ -1,6 +1,11 @@
 #include <imgui.h>
 
 #include <imgui_nodes.hpp>
+#include <imgui_nodes_threads.hpp>
+#include <imgui_nodes_alloc.hpp>
+#include <imgui_nodes_graph.hpp>
+#include <imgui_nodes_undo.hpp>
+#include <imgui_nodes_serialize.hpp>
 
 #include <vector>
 #include <algorithm>
@@ -10,6 +15,9 @@
 #include <variant>
 #include <array>
 #include <cctype>
+#include <memory>
+#include <string>
+#include <cstring>
 
 namespace {
 
@@ -39,18 +47,26 @@ static bool findIgnoreCase(std::string_view const &haystack, std::string_view co
     return it != haystack.cend();
 }
 
+// Clipboard payload helpers for the plain data members of the node types.
+template<typename T>
+void saveBytes(std::vector<unsigned char> &out, T const &value) {
+    unsigned char const *bytes = reinterpret_cast<unsigned char const*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+void loadBytes(unsigned char const *&data, unsigned char const *end, T &value) {
+    if (end - data >= (std::ptrdiff_t)sizeof(T)) {
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+    }
+}
+
 inline ImVec2 operator+(const ImVec2& lhs, const ImVec2 rhs) { return ImVec2(lhs.x + rhs.x, lhs.y + rhs.y); }
 inline ImVec2 operator-(const ImVec2& lhs, const ImVec2 rhs) { return ImVec2(lhs.x - rhs.x, lhs.y - rhs.y); }
 
 } // unnamed namespace
 
-struct Edge {
-    int sourceNode;
-    int sourceSlot;
-    int sinkNode;
-    int sinkSlot;
-};
-
 enum class DataType { None = -1, Float1 = 0, Float2 = 1, Float3 = 2, Float4 = 3 };
 
 template<typename... T>
@@ -59,12 +75,11 @@ struct Graph
     using NodeType = std::variant<T...>;
 
     int getFreeNodeSlot() {
-        for (int i = 0; i < (int)nodes.size(); ++i) {
-            if (std::holds_alternative<std::monostate>(nodes[i]))
-                return i;
+        int slot = store.addNode().index;
+        if (slot >= (int)nodes.size()) {
+            nodes.resize(slot + 1);
         }
-        nodes.emplace_back(std::monostate{});
-        return (int)nodes.size() - 1;
+        return slot;
     }
 
     bool newNodePopup(bool forceOpen = false) {
@@ -88,6 +103,7 @@ struct Graph
                         if (ImGui::Selectable(type::name)) {
                             int nodeslot = getFreeNodeSlot();
                             nodes[nodeslot] = type{ nodes::NodeState(nodeslot, popupPos) };
+                            history.recordNodeAdd(nodeslot);
                         }
                     }
                 }
@@ -103,31 +119,104 @@ struct Graph
         return false;
     }
 
-    void deleteEdge(int index) {
-        edges.erase(edges.begin() + index);
-    }
-
     void deleteNode(int index) {
-        // erasing changes positions of other nodes which would make edges wrong.
-        // -> insert placeholder instead
-        edges.erase(std::remove_if(edges.begin(), edges.end(), [index](Edge &c) {
-            return c.sinkNode == index || c.sourceNode == index;
-        }), edges.end());
+        // node slots are reused by the store -> insert placeholder instead of erasing
+        store.removeNodeAt(index);
         nodes[index] = std::monostate{};
+        nodeArea.ForgetNode(index);
     }
 
     void deleteSelectedItems() {
-        for (int i = (int)nodeArea.state.selectedEdges.selectedItems.size() - 1; i >= 0 ; --i) {
-            if (nodeArea.state.selectedEdges.selectedItems[i]) {
-                deleteEdge(i);
+        history.recordRemoveSelected(nodeArea);
+        store.removeSelected(nodeArea.state.selectedNodes, nodeArea.state.selectedEdges, [this](int index) {
+            nodes[index] = std::monostate{};
+            nodeArea.ForgetNode(index);
+        });
+        nodeArea.clearAllSelections();
+    }
+
+    // Graphs are moved around inside the node variants, so the hooks are refreshed every frame
+    // instead of capturing this once.
+    void setupHistory() {
+        history.graph = &store;
+        history.hooks.node = [this](int id) -> nodes::NodeState* {
+            if (id < 0 || id >= (int)nodes.size() || std::holds_alternative<std::monostate>(nodes[id])) {
+                return nullptr;
+            }
+            return &getNodeState(nodes[id]);
+        };
+        history.hooks.takeNode = [this](int id, size_t &bytes) -> std::shared_ptr<void> {
+            bytes = sizeof(NodeType);
+            auto payload = std::make_shared<NodeType>(std::move(nodes[id]));
+            nodes[id] = std::monostate{};
+            return payload;
+        };
+        history.hooks.restoreNode = [this](int id, std::shared_ptr<void> const &payload) {
+            if (id >= (int)nodes.size()) {
+                nodes.resize(id + 1);
+            }
+            nodes[id] = std::move(*std::static_pointer_cast<NodeType>(payload));
+        };
+    }
+
+    nodes::SubgraphHooks clipboardHooks() {
+        nodes::SubgraphHooks hooks;
+        hooks.node = history.hooks.node;
+        hooks.saveNode = [this](int id, std::vector<unsigned char> &out) {
+            out.push_back((unsigned char)nodes[id].index());
+            std::visit([&out](auto &node) {
+                if constexpr(!std::is_same_v<decltype(node), std::monostate&>) {
+                    node.save(out);
+                }
+            }, nodes[id]);
+        };
+        hooks.loadNode = [this](nodes::NodeState &&state, unsigned char const *data, size_t size) {
+            int id = state.id;
+            if (id >= (int)nodes.size()) {
+                nodes.resize(id + 1);
             }
+            size_t index = size > 0 ? data[0] : 0;
+            size_t alternative = 0;
+            for_each_alternative<NodeType>([&, this](auto S) {
+                using type = typename decltype(S)::type;
+                if constexpr(!std::is_same_v<type, std::monostate>) {
+                    if (alternative == index) {
+                        type node{ std::move(state) };
+                        node.load(data + 1, data + size);
+                        nodes[id] = std::move(node);
+                    }
+                }
+                ++alternative;
+            });
+        };
+        return hooks;
+    }
+
+    void copySelection() {
+        std::vector<unsigned char> blob;
+        if (nodes::CopySubgraph(nodeArea, store, clipboardHooks(), blob) > 0) {
+            std::string text;
+            nodes::EncodeBase64(blob.data(), blob.size(), text);
+            ImGui::SetClipboardText(text.c_str());
         }
-        for (int i = (int)nodeArea.state.selectedNodes.selectedItems.size() - 1; i >= 0; --i) {
-            if (nodeArea.state.selectedNodes.selectedItems[i]) {
-                deleteNode(i);
+    }
+
+    void paste() {
+        char const *text = ImGui::GetClipboardText();
+        std::vector<unsigned char> blob;
+        std::vector<int> newNodes;
+        if (!text || !nodes::DecodeBase64(text, blob) ||
+            nodes::PasteSubgraph(nodeArea, store, clipboardHooks(), blob.data(), blob.size(), nodeArea.GetAbsoluteMousePos(), &newNodes) <= 0) {
+            return;
+        }
+        for (int id : newNodes) {
+            history.recordNodeAdd(id);
+        }
+        for (int id : newNodes) {
+            for (int e = store.firstOutgoing(id); e != -1; e = store.nextOutgoing(e)) {
+                history.recordEdgeAdd(e);
             }
         }
-        nodeArea.clearAllSelections();
     }
 
     void draw(bool updateStyle) {
@@ -135,59 +224,86 @@ struct Graph
             nodeArea.style.generate();
         }
 
+        setupHistory();
+
         bool forcePopup = false;
 
         auto userAction = [&](nodes::UserAction action) {
             switch (action) {
             case nodes::UserAction::NewEdge:
             {
-                Edge newEdge;
+                nodes::GraphStore::Edge newEdge;
                 nodeArea.GetNewEdge(&newEdge.sourceNode, &newEdge.sourceSlot, &newEdge.sinkNode, &newEdge.sinkSlot);
                 if (newEdge.sourceNode == -1 || newEdge.sinkNode == -1) {
                     forcePopup = true;
                 } else {
-                    auto replacedEdge = std::find_if(edges.begin(), edges.end(), [&newEdge](Edge const &edge) {
-                        return edge.sinkNode == newEdge.sinkNode &&
-                            edge.sinkSlot == newEdge.sinkSlot;
-                    });
-                    if (replacedEdge != edges.end()) {
-                        deleteEdge((int)(replacedEdge - edges.begin()));
+                    int replacedEdge = store.findIncoming(newEdge.sinkNode, newEdge.sinkSlot);
+                    if (replacedEdge != -1) {
+                        history.recordEdgeRemove(replacedEdge);
+                        store.removeEdgeAt(replacedEdge);
                     }
-                    edges.emplace_back(std::move(newEdge));
+                    nodes::EdgeHandle edge = store.addEdge(newEdge.sourceNode, newEdge.sourceSlot, newEdge.sinkNode, newEdge.sinkSlot);
+                    history.recordEdgeAdd(edge.index);
                 }
                 break;
             }
             case nodes::UserAction::Delete:
                 deleteSelectedItems();
                 break;
+            case nodes::UserAction::Copy:
+                copySelection();
+                break;
+            case nodes::UserAction::Cut:
+                copySelection();
+                deleteSelectedItems();
+                break;
+            case nodes::UserAction::Paste:
+                paste();
+                break;
+            case nodes::UserAction::Undo:
+                history.undo(nodeArea);
+                break;
+            case nodes::UserAction::Redo:
+                history.redo(nodeArea);
+                break;
             }
         };
 
-        nodeArea.BeginNodeArea(userAction, updateStyle ? nodes::NodeAreaFlags_UpdateStyle : 0);
+        if (nodeArea.BeginNodeArea(userAction, updateStyle ? nodes::NodeAreaFlags_UpdateStyle : 0)) {
+            for (int i = 0; i < (int)nodes.size(); ++i) {
+                ImGui::PushID(i);
+                std::visit([this](auto &node)->void {
+                    if constexpr(!std::is_same_v<decltype(node), std::monostate&>) {
+                        node.draw(nodeArea);
+                    }
+                }, nodes[i]);
+                ImGui::PopID();
+            }
 
-        for (int i = 0; i < (int)nodes.size(); ++i) {
-            ImGui::PushID(i);
-            std::visit([this](auto &node)->void {
-                if constexpr(!std::is_same_v<decltype(node), std::monostate&>) {
-                    node.draw(nodeArea);
+            edgeDescs.clear();
+            for (int i = 0; i < store.edgeSlotCount(); ++i) {
+                if (!store.edgeAlive(i)) {
+                    continue;
+                }
+                auto const &edge = store.edge(i);
+                edgeDescs.push_back({ i,
+                    &getNodeState(nodes[edge.sourceNode]), edge.sourceSlot,
+                    &getNodeState(nodes[edge.sinkNode]), edge.sinkSlot });
+            }
+            edgeDrawn.resize((int)edgeDescs.size());
+            nodeArea.DrawEdges(edgeDescs.data(), (int)edgeDescs.size(), edgeDrawn.Data);
+            for (int i = 0; i < (int)edgeDescs.size(); ++i) {
+                if (!edgeDrawn[i]) {
+                    store.removeEdgeAt(edgeDescs[i].edgeId);
                 }
-            }, nodes[i]);
-            ImGui::PopID();
-        }
-
-        for (int i = (int)edges.size() - 1; i >= 0; --i) {
-            auto const &edge = edges[i];
-            if (!nodeArea.DrawEdge(i,
-                getNodeState(nodes[edge.sourceNode]), edge.sourceSlot,
-                getNodeState(nodes[edge.sinkNode]), edge.sinkSlot))
-            {
-                deleteEdge(i);
             }
-        }
 
-        newNodePopup(forcePopup);
+            newNodePopup(forcePopup);
+        }
 
         nodeArea.EndNodeArea();
+        nodeArea.DrawMinimap();
+        history.update(nodeArea);
 
         //ImGui::SetCursorPos(ImVec2(10.f, 5.f));
         //ImGui::Text("x %.2f, y %.2f\nz %.2f", nodeArea.state.innerWndPos.x, nodeArea.state.innerWndPos.y, nodeArea.state.zoom);
@@ -203,8 +319,11 @@ struct Graph
         }, node);
     };
 
-    std::vector<NodeType> nodes;
-    std::vector<Edge> edges;
+    std::vector<NodeType> nodes;  // indexed by store node slot
+    nodes::GraphStore store;
+    nodes::UndoHistory history;
+    std::vector<nodes::EdgeDesc> edgeDescs;
+    ImVector<bool> edgeDrawn;   // DrawEdges results, reused like edgeDescs
     nodes::NodeArea nodeArea;
 };
 
@@ -214,6 +333,8 @@ struct BaseNode {
     nodes::NodeState state;
 
     void draw(nodes::NodeArea &) {}
+    void save(std::vector<unsigned char> &) const {}
+    void load(unsigned char const *, unsigned char const *) {}
 };
 
 struct InputNode : public BaseNode<InputNode> {
@@ -224,6 +345,15 @@ struct InputNode : public BaseNode<InputNode> {
     DataType outputType = DataType::Float1;
     std::array<float, 4> floats = {};
 
+    void save(std::vector<unsigned char> &out) const {
+        saveBytes(out, outputType);
+        saveBytes(out, floats);
+    }
+    void load(unsigned char const *data, unsigned char const *end) {
+        loadBytes(data, end, outputType);
+        loadBytes(data, end, floats);
+    }
+
     void draw(nodes::NodeArea &area) {
         if (area.BeginNode(state)) {
             ImGui::Text("%s (%d)", name, state.id);
@@ -276,6 +406,9 @@ struct Combine : public BaseNode<Combine> {
 
     int numInputs = 1;
 
+    void save(std::vector<unsigned char> &out) const { saveBytes(out, numInputs); }
+    void load(unsigned char const *data, unsigned char const *end) { loadBytes(data, end, numInputs); }
+
     void draw(nodes::NodeArea &area) {
         if (area.BeginNode(state)) {
             ImGui::Text("%s (%d)", name, state.id);
@@ -305,6 +438,9 @@ struct ConstantColor : public BaseNode<ConstantColor> {
 
     float color[4] = {1.f, 0.f, 0.f, 1.f};
 
+    void save(std::vector<unsigned char> &out) const { saveBytes(out, color); }
+    void load(unsigned char const *data, unsigned char const *end) { loadBytes(data, end, color); }
+
     void draw(nodes::NodeArea &area) {
         if (area.BeginNode(state)) {
             ImGui::Text("%s (%d)", name, state.id);
@@ -328,6 +464,13 @@ struct CodeNode : public BaseNode<CodeNode> {
 
     char code[1024*16] = "function(float4 input, int _) {\n  return input * 4.0;\n }\n";
 
+    void save(std::vector<unsigned char> &out) const { out.insert(out.end(), code, code + std::strlen(code)); }
+    void load(unsigned char const *data, unsigned char const *end) {
+        size_t length = std::min((size_t)(end - data), sizeof(code) - 1);
+        std::memcpy(code, data, length);
+        code[length] = '\0';
+    }
+
     void draw(nodes::NodeArea &area) {
         if (area.BeginNode(state, true)) {
             ImVec2 originPos = ImGui::GetCursorPos();
@@ -394,12 +537,15 @@ Graph<std::monostate, InputNode, OutputNode, Combine, Recursion, ConstantColor,
 void AddSomeNodes()
 {
     ImVec2 offset(10000.f, 10000.f);
-    graph.nodes.emplace_back(InputNode{ nodes::NodeState((int)graph.nodes.size(), ImVec2(-400, -200) + offset) });
-    graph.nodes.emplace_back(Combine{ nodes::NodeState((int)graph.nodes.size(), ImVec2(-100, 0) + offset) });
-    graph.nodes.emplace_back(OutputNode{ nodes::NodeState((int)graph.nodes.size(), ImVec2(300, 100) + offset) });
-
-    graph.edges.emplace_back(Edge{ 0, 0, 1, 0 });
-    graph.edges.emplace_back(Edge{ 1, 0, 2, 0 });
+    int input = graph.getFreeNodeSlot();
+    graph.nodes[input] = InputNode{ nodes::NodeState(input, ImVec2(-400, -200) + offset) };
+    int combine = graph.getFreeNodeSlot();
+    graph.nodes[combine] = Combine{ nodes::NodeState(combine, ImVec2(-100, 0) + offset) };
+    int output = graph.getFreeNodeSlot();
+    graph.nodes[output] = OutputNode{ nodes::NodeState(output, ImVec2(300, 100) + offset) };
+
+    graph.store.addEdge(input, 0, combine, 0);
+    graph.store.addEdge(combine, 0, output, 0);
 }
 
 void imgui_nodes_example_window(bool updateStyle)
@@ -420,6 +566,8 @@ void imgui_nodes_example_window(bool updateStyle)
     static bool initialized = false;
     if (!initialized) {
         AddSomeNodes();
+        graph.nodeArea.state.threadPool = std::make_shared<nodes::ThreadPool>();
+        graph.nodeArea.state.allocator = std::make_shared<nodes::NodeAllocator>();
         initialized = true;
     }
 
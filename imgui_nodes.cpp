@@ -1,4 +1,8 @@
 #include "imgui_nodes.hpp"
+#include "imgui_nodes_threads.hpp"
+#include "imgui_nodes_alloc.hpp"
+#include "imgui_nodes_queue.hpp"
+#include "imgui_nodes_replay.hpp"
 
 #include <imgui_internal.h>
 
@@ -9,6 +13,8 @@
 #include <algorithm>
 #include <array>
 #include <limits>
+#include <chrono>
+#include <cstring>
 
 #ifdef IMGUI_NODES_DEBUG
 #include <sstream>
@@ -40,6 +46,7 @@ inline ImVec2& operator+=(ImVec2& lhs, const ImVec2& rhs) { lhs.x += rhs.x; lhs.
 
 inline bool operator==(const ImVec2& lhs, const ImVec2& rhs) { return lhs.x == rhs.x && lhs.y == rhs.y; }
 inline bool operator!=(const ImVec2& lhs, const ImVec2& rhs) { return !(lhs == rhs); }
+inline bool operator==(const ImVec4& lhs, const ImVec4& rhs) { return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z && lhs.w == rhs.w; }
 
 inline ImVec2 operator-(const ImVec2& lhs) { return ImVec2(-lhs.x, -lhs.y); }
 
@@ -207,38 +214,206 @@ bool handleNodeDragSelection(NodeArea &area, int nodeId, ImRect rect) {
     return false;
 }
 
+bool edgeTouchesRect(ImRect const &rect, bool enclosedOnly, const ImVec2& p1, const ImVec2& p2, const ImVec2& p3, const ImVec2& p4) {
+    bool contained = rect.Contains(p1) && rect.Contains(p4);
+    if (!contained && !enclosedOnly) {
+        ImVec2 q0 = rect.Min;
+        ImVec2 q1 = ImVec2(rect.Max.x, rect.Min.y);
+        ImVec2 q2 = ImVec2(rect.Min.x, rect.Max.y);
+        ImVec2 q3 = rect.Max;
+
+        contained =
+            IntersectBezierAndLine(q0, q1, p1, p2, p3, p4) ||
+            IntersectBezierAndLine(q0, q2, p1, p2, p3, p4) ||
+            IntersectBezierAndLine(q3, q1, p1, p2, p3, p4) ||
+            IntersectBezierAndLine(q3, q2, p1, p2, p3, p4);
+    }
+    return contained;
+}
+
+bool applyEdgeDragSelection(NodeArea &area, int edgeId) {
+    if (area.state.mode == NodeArea::Mode::SelectionCaptureAdd) {
+        area.state.selectedEdges.addToSelection(edgeId);
+    } else if (area.state.mode == NodeArea::Mode::SelectionCaptureRemove) {
+        area.state.selectedEdges.removeFromSelection(edgeId);
+    }
+    return area.state.mode == NodeArea::Mode::Selecting;
+}
+
 bool handleEdgeDragSelection(NodeArea &area, int edgeId, const ImVec2& p1, const ImVec2& p2, const ImVec2& p3, const ImVec2& p4) {
     if (area.state.mode != NodeArea::Mode::None) {
         ImRect selectionRect = defaultBoundsRect;
         selectionRect.Add(area.state.dragStart);
         selectionRect.Add(area.state.dragEnd);
 
-        bool contained = selectionRect.Contains(p1) && selectionRect.Contains(p4);
-        if (!contained && !ImGui::GetIO().KeyAlt) {
-            ImVec2 q0 = selectionRect.Min;
-            ImVec2 q1 = ImVec2(selectionRect.Max.x, selectionRect.Min.y);
-            ImVec2 q2 = ImVec2(selectionRect.Min.x, selectionRect.Max.y);
-            ImVec2 q3 = selectionRect.Max;
-
-            contained =
-                IntersectBezierAndLine(q0, q1, p1, p2, p3, p4) ||
-                IntersectBezierAndLine(q0, q2, p1, p2, p3, p4) ||
-                IntersectBezierAndLine(q3, q1, p1, p2, p3, p4) ||
-                IntersectBezierAndLine(q3, q2, p1, p2, p3, p4);
-        }
-
-        if (contained) {
-            if (area.state.mode == NodeArea::Mode::SelectionCaptureAdd) {
-                area.state.selectedEdges.addToSelection(edgeId);
-            } else if (area.state.mode == NodeArea::Mode::SelectionCaptureRemove) {
-                area.state.selectedEdges.removeFromSelection(edgeId);
-            }
-            return area.state.mode == NodeArea::Mode::Selecting;
+        if (edgeTouchesRect(selectionRect, ImGui::GetIO().KeyAlt, p1, p2, p3, p4)) {
+            return applyEdgeDragSelection(area, edgeId);
         }
     }
     return false;
 }
 
+// Without a pool the ranges are the same as with one, so callers may keep per chunk state.
+void runParallel(ThreadPool *pool, int count, int grainSize, std::function<void(int, int, int)> const &fn) {
+    if (pool) {
+        pool->parallelFor(count, grainSize, fn);
+    } else {
+        for (int begin = 0; begin < count; begin += grainSize) {
+            fn(begin, std::min(begin + grainSize, count), 0);
+        }
+    }
+}
+
+// Adaptive curve flattening, same criterion as ImDrawList::PathBezierCubicCurveTo uses when no
+// segment count is given. Appends the points after p1.
+void flattenBezier(std::vector<ImVec2> &path, float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, float tessTol, int level) {
+    float dx = x4 - x1;
+    float dy = y4 - y1;
+    float d2 = std::abs((x2 - x4) * dy - (y2 - y4) * dx);
+    float d3 = std::abs((x3 - x4) * dy - (y3 - y4) * dx);
+    if ((d2 + d3) * (d2 + d3) < tessTol * (dx * dx + dy * dy)) {
+        path.push_back(ImVec2(x4, y4));
+    } else if (level < 10) {
+        float x12 = (x1 + x2) * 0.5f, y12 = (y1 + y2) * 0.5f;
+        float x23 = (x2 + x3) * 0.5f, y23 = (y2 + y3) * 0.5f;
+        float x34 = (x3 + x4) * 0.5f, y34 = (y3 + y4) * 0.5f;
+        float x123 = (x12 + x23) * 0.5f, y123 = (y12 + y23) * 0.5f;
+        float x234 = (x23 + x34) * 0.5f, y234 = (y23 + y34) * 0.5f;
+        float x1234 = (x123 + x234) * 0.5f, y1234 = (y123 + y234) * 0.5f;
+        flattenBezier(path, x1, y1, x12, y12, x123, y123, x1234, y1234, tessTol, level + 1);
+        flattenBezier(path, x1234, y1234, x234, y234, x34, y34, x4, y4, tessTol, level + 1);
+    }
+}
+
+// Appends an open, anti-aliased thick polyline laid out like ImDrawList::AddPolyline does for
+// untextured anti-aliased lines: four vertices per point (fringe, inner, inner, fringe).
+void strokePolyline(NodeArea::EdgeGeometry &geometry, ImVec2 const *points, int count, ImU32 col, float thickness, float fringe, ImVec2 uvWhite) {
+    if (count < 2) {
+        return;
+    }
+    NodeArea::EdgeGeometry::Run run;
+    run.vtxBegin = (int)geometry.vertices.size();
+    run.vtxCount = count * 4;
+    run.idxBegin = (int)geometry.indices.size();
+    run.idxCount = (count - 1) * 18;
+
+    const ImU32 colTrans = col & ~IM_COL32_A_MASK;
+    const float halfInner = std::max((thickness - fringe) * 0.5f, 0.f);
+    const float halfOuter = halfInner + fringe;
+
+    geometry.vertices.resize(run.vtxBegin + run.vtxCount);
+    ImDrawVert *vtx = geometry.vertices.data() + run.vtxBegin;
+
+    ImVec2 prevNormal;
+    for (int i = 0; i < count; ++i) {
+        ImVec2 normal = prevNormal;
+        if (i + 1 < count) {
+            ImVec2 d = points[i + 1] - points[i];
+            float len2 = ImLengthSqr(d);
+            if (len2 > 0.f) {
+                d = d / std::sqrt(len2);
+            }
+            normal = ImVec2(d.y, -d.x);
+        }
+        ImVec2 miter = normal;
+        if (i > 0 && i + 1 < count) {
+            // average the normals of the adjacent segments and fix up the length for the miter
+            miter = (prevNormal + normal) * 0.5f;
+            float d2 = ImLengthSqr(miter);
+            if (d2 > 0.000001f) {
+                miter = miter * std::min(1.f / d2, 100.f);
+            }
+        }
+        prevNormal = normal;
+
+        ImDrawVert *v = vtx + i * 4;
+        v[0].pos = points[i] + miter * halfOuter; v[0].uv = uvWhite; v[0].col = colTrans;
+        v[1].pos = points[i] + miter * halfInner; v[1].uv = uvWhite; v[1].col = col;
+        v[2].pos = points[i] - miter * halfInner; v[2].uv = uvWhite; v[2].col = col;
+        v[3].pos = points[i] - miter * halfOuter; v[3].uv = uvWhite; v[3].col = colTrans;
+    }
+
+    geometry.indices.resize(run.idxBegin + run.idxCount);
+    ImDrawIdx *idx = geometry.indices.data() + run.idxBegin;
+    for (int i = 0; i + 1 < count; ++i) {
+        ImDrawIdx i1 = (ImDrawIdx)(i * 4);
+        ImDrawIdx i2 = (ImDrawIdx)((i + 1) * 4);
+        const ImDrawIdx quads[18] = {
+            (ImDrawIdx)(i2 + 1), (ImDrawIdx)(i1 + 1), (ImDrawIdx)(i1 + 2), (ImDrawIdx)(i1 + 2), (ImDrawIdx)(i2 + 2), (ImDrawIdx)(i2 + 1),
+            (ImDrawIdx)(i2 + 1), (ImDrawIdx)(i1 + 1), (ImDrawIdx)(i1 + 0), (ImDrawIdx)(i1 + 0), (ImDrawIdx)(i2 + 0), (ImDrawIdx)(i2 + 1),
+            (ImDrawIdx)(i2 + 2), (ImDrawIdx)(i1 + 2), (ImDrawIdx)(i1 + 3), (ImDrawIdx)(i1 + 3), (ImDrawIdx)(i2 + 3), (ImDrawIdx)(i2 + 2)
+        };
+        std::memcpy(idx + i * 18, quads, sizeof(quads));
+    }
+    geometry.runs.push_back(run);
+}
+
+// Tessellates and strokes the given curves (in parallel if a pool is given) into per chunk
+// buffers and then appends them to the draw list in order.
+// The inner draw data is scaled by the zoom level (screenScale) when copied to the outer window.
+// Flatness tolerance and anti-aliasing fringe are therefore chosen in screen pixels, so the
+// segment count of a curve follows its size on screen instead of staying constant.
+void drawEdgeStrokes(ThreadPool *pool, std::vector<NodeArea::EdgeGeometry> &chunks, ImDrawList *drawList, NodeArea::EdgeStroke const *strokes, int count, float screenScale) {
+    const int grainSize = 256;
+    const int chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount > (int)chunks.size()) {
+        chunks.resize(chunkCount);
+    }
+
+    // the tolerance is compared against squared distances
+    const float tessTol = ImGui::GetStyle().CurveTessellationTol / (screenScale * screenScale);
+    const float fringe = (drawList->Flags & ImDrawListFlags_AntiAliasedLines) ? drawList->_FringeScale / screenScale : 0.f;
+    const ImVec2 uvWhite = ImGui::GetDrawListSharedData()->TexUvWhitePixel;
+
+    runParallel(pool, count, grainSize, [&](int begin, int end, int) {
+        NodeArea::EdgeGeometry &geometry = chunks[begin / grainSize];
+        geometry.vertices.clear();
+        geometry.indices.clear();
+        geometry.runs.clear();
+        for (int i = begin; i < end; ++i) {
+            NodeArea::EdgeStroke const &stroke = strokes[i];
+            geometry.points.clear();
+            geometry.points.push_back(stroke.p1);
+            flattenBezier(geometry.points,
+                stroke.p1.x, stroke.p1.y, stroke.cp1.x, stroke.cp1.y,
+                stroke.cp2.x, stroke.cp2.y, stroke.p2.x, stroke.p2.y, tessTol, 0);
+            strokePolyline(geometry, geometry.points.data(), (int)geometry.points.size(),
+                stroke.color, stroke.thickness, fringe, uvWhite);
+        }
+    });
+
+    for (int c = 0; c < chunkCount; ++c) {
+        NodeArea::EdgeGeometry const &geometry = chunks[c];
+        for (auto const &run : geometry.runs) {
+            drawList->PrimReserve(run.idxCount, run.vtxCount);
+            ImDrawIdx base = (ImDrawIdx)drawList->_VtxCurrentIdx;
+            std::memcpy(drawList->_VtxWritePtr, geometry.vertices.data() + run.vtxBegin, run.vtxCount * sizeof(ImDrawVert));
+            for (int i = 0; i < run.idxCount; ++i) {
+                drawList->_IdxWritePtr[i] = (ImDrawIdx)(geometry.indices[run.idxBegin + i] + base);
+            }
+            drawList->_VtxWritePtr += run.vtxCount;
+            drawList->_IdxWritePtr += run.idxCount;
+            drawList->_VtxCurrentIdx += run.vtxCount;
+        }
+    }
+}
+
+void addEdgeStroke(NodeArea &area, NodeArea::EdgeLayer layer, ImVec2 p1, ImVec2 cp1, ImVec2 cp2, ImVec2 p2, ImU32 color, float thickness) {
+    NodeArea::EdgeStroke stroke = { p1, cp1, cp2, p2, color, thickness };
+    area.state.edgeLayers[layer].push_back(stroke);
+}
+
+// Emits all batched edges layer by layer as one run of vertices.
+void flushEdgeLayers(NodeArea &area) {
+    std::vector<NodeArea::EdgeStroke> &strokes = area.state.edgeStrokes;
+    strokes.clear();
+    for (auto &layer : area.state.edgeLayers) {
+        strokes.insert(strokes.end(), layer.begin(), layer.end());
+        layer.clear();
+    }
+    drawEdgeStrokes(area.state.threadPool.get(), area.state.edgeGeometry, ImGui::GetWindowDrawList(), strokes.data(), (int)strokes.size(), area.state.zoom);
+}
+
 ImGuiContext* setupInnerContext(ImGuiContext* outerContext) {
     ImGuiContext *innerContext = ImGui::CreateContext(outerContext->IO.Fonts);
 
@@ -306,6 +481,47 @@ void innerContextNewFrame(ImGuiContext const* outerContext, ImGuiContext* innerC
     }
 }
 
+// Transforms the clip rect of a source draw cmd into the target and reclips it. Fully clipped
+// commands get an empty user callback.
+void transformDrawCmdClipRect(ImDrawCmd &targetCmd, ImDrawCmd const &sourceCmd, ImRect const &targetClip, ImVec2 scale, ImVec2 translate) {
+    ImVec2 clipRectMin(sourceCmd.ClipRect.x, sourceCmd.ClipRect.y);
+    ImVec2 clipRectMax(sourceCmd.ClipRect.z, sourceCmd.ClipRect.w);
+
+    ImRect clipRect(clipRectMin * scale + translate, clipRectMax * scale + translate);
+    clipRect.ClipWith(targetClip);
+
+    if (clipRect.Max.x <= clipRect.Min.x || clipRect.Max.y <= clipRect.Min.y) {
+        targetCmd.UserCallback = (ImDrawCallback)([](const ImDrawList*, const ImDrawCmd*) {
+            // This would be fully clipped, so skip it to avoid errors.
+            // Adding an empty user callback for rendering is the easiest way to do so ...
+            // ... Still it would be better to skip the relevant data in the vertex/index buffers
+            // and omit the draw cmd (TODO).
+        });
+    }
+
+    targetCmd.ClipRect = ImVec4(clipRect.Min.x, clipRect.Min.y, clipRect.Max.x, clipRect.Max.y);
+}
+
+// Picks the zoom band font for the current zoom level and scales it to the layout size of the
+// first band, so node layouts do not depend on the band in use.
+void applyZoomFont(std::vector<ImFont*> const &zoomFonts, ImGuiContext* innerContext, float zoom) {
+    if (zoomFonts.empty()) {
+        return;
+    }
+    float layoutSize = zoomFonts.front()->FontSize;
+    float targetSize = layoutSize * zoom;
+
+    ImFont *font = zoomFonts.back();
+    for (ImFont *band : zoomFonts) {
+        if (band->FontSize >= targetSize) {
+            font = band;
+            break;
+        }
+    }
+    innerContext->IO.FontDefault = font;
+    innerContext->IO.FontGlobalScale *= layoutSize / font->FontSize;
+}
+
 void copyTransformDrawList(ImDrawList *targetDrawList, ImDrawList const*sourceDrawList, ImVec2 scale = ImVec2(1.f, 1.f), ImVec2 translate = {}) {
     targetDrawList->Flags = sourceDrawList->Flags;
     ImRect targetClip(targetDrawList->_ClipRectStack.back());
@@ -348,42 +564,168 @@ void copyTransformDrawList(ImDrawList *targetDrawList, ImDrawList const*sourceDr
             targetDrawList->PrimWriteIdx((ImDrawIdx)(sourceDrawList->IdxBuffer[sourceIdx] + indexBase));
         }
 
-        ImVec2 clipRectMin(sourceDrawCmd.ClipRect.x, sourceDrawCmd.ClipRect.y);
-        ImVec2 clipRectMax(sourceDrawCmd.ClipRect.z, sourceDrawCmd.ClipRect.w);
+        transformDrawCmdClipRect(cmdBuffer, sourceDrawCmd, targetClip, scale, translate);
+    }
+}
 
-        ImRect clipRect(clipRectMin * scale + translate, clipRectMax * scale + translate);
-        clipRect.ClipWith(targetClip);
+// Parallel variant of the copy loop in copyTransformDrawCmds. Destination ranges of all source
+// lists are computed upfront with a prefix sum, so every list can be transformed independently
+// into the pre-sized target buffers. Instead of rebasing the indices, the VtxOffset of every
+// copied draw cmd is moved by the start of its source list, which requires a renderer supporting
+// VtxOffset. Source lists larger than 64k vertices are copied as they are.
+void copyTransformDrawListsParallel(ThreadPool *pool, ImDrawList *targetDrawList, ImDrawData const *sourceDrawData, float scale, ImVec2 translate, std::vector<int> &prefix) {
+    const int listCount = sourceDrawData->CmdListsCount;
+    ImRect targetClip(targetDrawList->_ClipRectStack.back());
 
-        if (clipRect.Max.x <= clipRect.Min.x || clipRect.Max.y <= clipRect.Min.y) {
-            cmdBuffer.UserCallback = (ImDrawCallback)([](const ImDrawList*, const ImDrawCmd*) {
-                // This would be fully clipped, so skip it to avoid errors.
-                // Adding an empty user callback for rendering is the easiest way to do so ...
-                // ... Still it would be better to skip the relevant data in the vertex/index buffers
-                // and omit the draw cmd (TODO).
-            });
+    // vertex, index and command offsets per list
+    prefix.resize((listCount + 1) * 3);
+    prefix[0] = targetDrawList->VtxBuffer.Size;
+    prefix[1] = targetDrawList->IdxBuffer.Size;
+    prefix[2] = targetDrawList->CmdBuffer.Size;
+    for (int i = 0; i < listCount; ++i) {
+        ImDrawList const *sourceDrawList = sourceDrawData->CmdLists[i];
+        prefix[(i + 1) * 3 + 0] = prefix[i * 3 + 0] + sourceDrawList->VtxBuffer.Size;
+        prefix[(i + 1) * 3 + 1] = prefix[i * 3 + 1] + sourceDrawList->IdxBuffer.Size;
+        prefix[(i + 1) * 3 + 2] = prefix[i * 3 + 2] + sourceDrawList->CmdBuffer.Size;
+    }
+    targetDrawList->VtxBuffer.resize(prefix[listCount * 3 + 0]);
+    targetDrawList->IdxBuffer.resize(prefix[listCount * 3 + 1]);
+    targetDrawList->CmdBuffer.resize(prefix[listCount * 3 + 2]);
+
+    ImVec2 scale2(scale, scale);
+    runParallel(pool, listCount, 8, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            ImDrawList const *sourceDrawList = sourceDrawData->CmdLists[i];
+            const int vtxBase = prefix[i * 3 + 0];
+            const int idxBase = prefix[i * 3 + 1];
+            const int cmdBase = prefix[i * 3 + 2];
+
+            ImDrawVert *vtxWrite = targetDrawList->VtxBuffer.Data + vtxBase;
+            for (int vtx = 0; vtx < sourceDrawList->VtxBuffer.Size; ++vtx) {
+                ImDrawVert const &vertex = sourceDrawList->VtxBuffer.Data[vtx];
+                vtxWrite[vtx].pos = vertex.pos * scale2 + translate;
+                vtxWrite[vtx].uv = vertex.uv;
+                vtxWrite[vtx].col = vertex.col;
+            }
+            if (sourceDrawList->IdxBuffer.Size > 0) {
+                std::memcpy(targetDrawList->IdxBuffer.Data + idxBase, sourceDrawList->IdxBuffer.Data, sourceDrawList->IdxBuffer.Size * sizeof(ImDrawIdx));
+            }
+
+            for (int dc = 0; dc < sourceDrawList->CmdBuffer.Size; ++dc) {
+                ImDrawCmd const &sourceDrawCmd = sourceDrawList->CmdBuffer.Data[dc];
+                ImDrawCmd targetCmd;
+                targetCmd.TextureId = sourceDrawCmd.TextureId;
+                targetCmd.VtxOffset = vtxBase + sourceDrawCmd.VtxOffset;
+                targetCmd.IdxOffset = idxBase + sourceDrawCmd.IdxOffset;
+                targetCmd.ElemCount = sourceDrawCmd.ElemCount;
+                targetCmd.UserCallback = nullptr;
+                targetCmd.UserCallbackData = nullptr;
+                transformDrawCmdClipRect(targetCmd, sourceDrawCmd, targetClip, scale2, translate);
+                targetDrawList->CmdBuffer.Data[cmdBase + dc] = targetCmd;
+            }
         }
+    });
 
-        cmdBuffer.ClipRect = ImVec4(clipRect.Min.x, clipRect.Min.y, clipRect.Max.x, clipRect.Max.y);
+    if (listCount > 0) {
+        targetDrawList->Flags = sourceDrawData->CmdLists[listCount - 1]->Flags;
+        targetDrawList->_FringeScale = sourceDrawData->CmdLists[listCount - 1]->_FringeScale / scale;
     }
+
+    // continue with a fresh vertex range after the copied data
+    targetDrawList->_VtxWritePtr = targetDrawList->VtxBuffer.Data + targetDrawList->VtxBuffer.Size;
+    targetDrawList->_IdxWritePtr = targetDrawList->IdxBuffer.Data + targetDrawList->IdxBuffer.Size;
+    targetDrawList->_CmdHeader.VtxOffset = targetDrawList->VtxBuffer.Size;
+    targetDrawList->_VtxCurrentIdx = 0;
 }
 
 // Copies all the draw call, vertex and index data from the inner imgui context to our current draw list:
 // * Translate and scale the vertices and clip rects accordingly
 // * Rebases the indices to fit into the outer index buffer
 // * Reclips the clip rects to our outer clip rect
-void copyTransformDrawCmds(ImDrawData* sourceDrawData, float scale, ImVec2 translate) {
+// With a thread pool and a renderer supporting VtxOffset, the lists are copied in parallel.
+void copyTransformDrawCmds(ImDrawData* sourceDrawData, float scale, ImVec2 translate, ThreadPool *pool, std::vector<int> &prefix) {
     ImDrawList *targetDrawList = ImGui::GetWindowDrawList();
 
-    for (int i = 0; i < sourceDrawData->CmdListsCount; ++i) {
-        ImDrawList const *sourceDrawList = sourceDrawData->CmdLists[i];
-        copyTransformDrawList(targetDrawList, sourceDrawList, ImVec2(scale, scale), translate);
+    if (pool && (targetDrawList->Flags & ImDrawListFlags_AllowVtxOffset)) {
+        copyTransformDrawListsParallel(pool, targetDrawList, sourceDrawData, scale, translate, prefix);
+    } else {
+        for (int i = 0; i < sourceDrawData->CmdListsCount; ++i) {
+            ImDrawList const *sourceDrawList = sourceDrawData->CmdLists[i];
+            copyTransformDrawList(targetDrawList, sourceDrawList, ImVec2(scale, scale), translate);
 
-        targetDrawList->_FringeScale = sourceDrawList->_FringeScale / scale;
+            targetDrawList->_FringeScale = sourceDrawList->_FringeScale / scale;
+        }
     }
     // make sure no one messes with our copied draw calls
     targetDrawList->AddDrawCmd();
 }
 
+// Draws the inner draw data scaled and translated to the current outer window.
+void emitInnerDrawData(NodeArea &area, ImDrawData *innerDrawData) {
+    NodeArea::InternalState &state = area.state;
+
+    // ImGui snaps geometry to whole pixels. This leads to jaggy movement when zooming in.
+    // We fix this by translating by the fract of the exact position.
+    // This is also why we push a one pixel bigger clip-rect than usually necessary.
+    ImVec2 fractInnerWndPos(
+        floor(fmodf(state.innerWndPos.x, 1.f) * state.zoom),
+        floor(fmodf(state.innerWndPos.y, 1.f) * state.zoom));
+
+    ImVec2 translate = state.outerContext->CurrentWindow->Pos + fractInnerWndPos;
+    float scale = state.zoom;
+
+    if ((state.flags & NodeAreaFlags_NoCopy) == 0) {
+        copyTransformDrawCmds(innerDrawData, scale, translate, state.threadPool.get(), state.copyPrefix);
+    }
+}
+
+double measureClockMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Grants the deferred measurements of this frame for the next one, nearest to the view first, as
+// many as the average cost suggests fit into the budget (at least one, so the backlog drains).
+void scheduleMeasurements(NodeArea &area) {
+    NodeArea::InternalState &state = area.state;
+    if (state.measureCandidates.empty()) {
+        return;
+    }
+    int grants = std::max(1, (int)(state.measureBudgetMs / std::max(state.measureCostMs, 0.001f)));
+    grants = std::min(grants, (int)state.measureCandidates.size());
+    std::partial_sort(state.measureCandidates.begin(), state.measureCandidates.begin() + grants, state.measureCandidates.end());
+    for (int i = 0; i < grants; ++i) {
+        int id = state.measureCandidates[i].second;
+        if (id >= (int)state.measureGrant.size()) {
+            state.measureGrant.resize(id + 1, -1);
+        }
+        state.measureGrant[id] = state.measureFrame + 1;
+    }
+    state.measureCandidates.clear();
+    state.invalidated = true; // keep rendering until the backlog is measured
+}
+
+// The output of the inner context can only change with input, window geometry changes, flags,
+// invalidations or pending interactions and size adaptions. Some frames are still rendered after
+// the last change since hover states and size dampening settle with a delay.
+bool isIdleFrame(NodeArea &area, NodeAreaFlags flags) {
+    NodeArea::InternalState &state = area.state;
+    const int settleFrames = 2;
+
+    bool quiet =
+        flags == 0 && state.flags == 0 &&
+        ImGui::GetCurrentContext()->InputEventsTrail.empty() &&
+        ImGui::GetWindowPos() == state.lastOuterWindowPos &&
+        ImGui::GetWindowSize() == state.lastOuterWindowSize &&
+        !state.invalidated && state.pendingDirtyRects.empty() &&
+        state.mode == NodeArea::Mode::None && !state.scrolling &&
+        !state.anyItemActive && !state.anySizeChanged &&
+        state.innerContext->OpenPopupStack.empty() &&
+        state.lastDrawData != nullptr;
+
+    state.quietFrames = quiet ? state.quietFrames + 1 : 0;
+    return state.quietFrames > settleFrames;
+}
+
 bool WasItemActive()
 {
     ImGuiContext& g = *GImGui;
@@ -439,12 +781,149 @@ ImVec2 getVisibleNodeRelativeOffset(Style const& style) {
     return ImVec2(style[Style_SlotRadius], style[Style_NodeBorderSize] * 0.5f);
 }
 
-ImRect getVisibleNodeArea(Style const& style) {
-    ImVec2 visibleNodeSize = ImGui::GetWindowSize() - getVisibleNodeRelativeOffset(style) * 2;
-    ImVec2 visibleNodePos = ImGui::GetWindowPos() + getVisibleNodeRelativeOffset(style);
+bool overlapsDirtyRect(NodeArea const &area, NodeState const &node) {
+    ImRect nodeRect(node.pos, node.pos + node.size);
+    for (auto const &dirty : area.state.dirtyRects) {
+        if (nodeRect.Overlaps(ImRect(dirty))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Screen position and size of the frame a node is drawn into: its own inner window or, with the
+// single window backend, its rect inside the node area window.
+ImVec2 getNodeFramePos(NodeArea const &area, NodeState const &node) {
+    return area.state.singleWindow ? area.state.innerWndPos + node.pos : ImGui::GetWindowPos();
+}
+
+ImVec2 getNodeFrameSize(NodeArea const &area, NodeState const &node) {
+    // unmeasured nodes get a minimal frame, so that their items keep a positive size
+    ImVec2 minSize = getVisibleNodeRelativeOffset(area.style) * 2.f + ImVec2(1.f, 1.f);
+    return area.state.singleWindow ? ImMax(node.size, minSize) : ImGui::GetWindowSize();
+}
+
+// Cursor position relative to the node frame
+ImVec2 getNodeCursorPos(NodeArea const &area, NodeState const &node) {
+    return ImGui::GetCursorScreenPos() - getNodeFramePos(area, node);
+}
+
+void setNodeCursorPos(NodeArea const &area, NodeState const &node, ImVec2 pos) {
+    ImGui::SetCursorScreenPos(getNodeFramePos(area, node) + pos);
+}
+
+ImRect getVisibleNodeArea(NodeArea const &area, NodeState const &node) {
+    ImVec2 visibleNodeSize = getNodeFrameSize(area, node) - getVisibleNodeRelativeOffset(area.style) * 2;
+    ImVec2 visibleNodePos = getNodeFramePos(area, node) + getVisibleNodeRelativeOffset(area.style);
     return ImRect(visibleNodePos, visibleNodePos + visibleNodeSize);
 }
 
+// Destroys the inner window of a node together with its child windows. Only call between
+// frames. Fails while a popup of the node is open or the window is in use otherwise.
+bool destroyNodeWindow(ImGuiContext &g, ImGuiWindow *nodeWindow) {
+    auto ownedByNode = [nodeWindow](ImGuiWindow const *window) {
+        return window && (window == nodeWindow || window->RootWindow == nodeWindow);
+    };
+    if (ownedByNode(g.MovingWindow) || ownedByNode(g.NavWindowingTarget) ||
+        ownedByNode(g.NavWindowingTargetAnim) || ownedByNode(g.NavWindowingListWindow))
+    {
+        return false;
+    }
+    for (ImGuiPopupData const &popup : g.OpenPopupStack) {
+        if (ownedByNode(popup.Window) || ownedByNode(popup.SourceWindow)) {
+            return false;
+        }
+    }
+    ImVector<ImGuiWindow*> owned;
+    for (ImGuiWindow *window : g.Windows) {
+        if (ownedByNode(window)) {
+            owned.push_back(window);
+        } else if (ownedByNode(window->ParentWindow)) {
+            return false;
+        }
+    }
+
+    // hover state is rebuilt by NewFrame, focus and the active item are dropped
+    if (ownedByNode(g.HoveredWindow)) g.HoveredWindow = nullptr;
+    if (ownedByNode(g.HoveredWindowUnderMovingWindow)) g.HoveredWindowUnderMovingWindow = nullptr;
+    if (ownedByNode(g.WheelingWindow)) g.WheelingWindow = nullptr;
+    if (ownedByNode(g.ActiveIdWindow)) ImGui::ClearActiveID();
+    if (ownedByNode(g.ActiveIdPreviousFrameWindow)) g.ActiveIdPreviousFrameWindow = nullptr;
+    if (ownedByNode(g.NavWindow)) ImGui::FocusWindow(nullptr);
+
+    for (ImGuiWindow *window : owned) {
+        g.Windows.erase(g.Windows.find(window));
+        ImGuiWindow **focus = g.WindowsFocusOrder.find(window);
+        if (focus != g.WindowsFocusOrder.end()) {
+            int order = (int)(focus - g.WindowsFocusOrder.begin());
+            g.WindowsFocusOrder.erase(focus);
+            for (int i = order; i < g.WindowsFocusOrder.Size; ++i) {
+                g.WindowsFocusOrder[i]->FocusOrder = (short)i;
+            }
+        }
+        g.WindowsById.SetVoidPtr(window->ID, nullptr);
+        IM_DELETE(window);
+    }
+    return true;
+}
+
+// Compacts and destroys the windows of nodes which were not drawn for a while, looking at a few
+// windows per frame. Requires the inner context to be current, before its NewFrame.
+void collectNodeWindows(NodeArea &area) {
+    NodeArea::InternalState &state = area.state;
+    ImGuiContext &g = *state.innerContext;
+
+    for (size_t i = 0; i < state.forgottenNodes.size();) {
+        char buf[64];
+#ifdef _MSC_VER
+        sprintf_s(buf, "##node%d", state.forgottenNodes[i]);
+#else
+        sprintf(buf, "##node%d", state.forgottenNodes[i]);
+#endif
+        ImGuiWindow *window = ImGui::FindWindowByName(buf);
+        if (!window || destroyNodeWindow(g, window)) {
+            state.forgottenNodes[i] = state.forgottenNodes.back();
+            state.forgottenNodes.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    if (state.compactWindowFrames <= 0 && state.destroyWindowFrames <= 0) {
+        return;
+    }
+    const int windowsPerFrame = 64;
+    for (int n = 0; n < windowsPerFrame && n < g.Windows.Size; ++n) {
+        if (state.windowGcCursor >= g.Windows.Size) {
+            state.windowGcCursor = 0;
+        }
+        int index = state.windowGcCursor++;
+        ImGuiWindow *window = g.Windows[index];
+        if (window->RootWindow != window || strncmp(window->Name, "##node", 6) != 0) {
+            continue;
+        }
+        int idleFrames = g.FrameCount - window->LastFrameActive;
+        if (state.destroyWindowFrames > 0 && idleFrames > state.destroyWindowFrames) {
+            if (destroyNodeWindow(g, window)) {
+                state.windowGcCursor = index;
+            }
+        } else if (state.compactWindowFrames > 0 && idleFrames > state.compactWindowFrames && !window->MemoryCompacted) {
+            ImGui::GcCompactTransientWindowBuffers(window);
+        }
+    }
+}
+
+// The node area window is hovered and, with the single window backend, no node is on top.
+bool isNodeAreaHovered(NodeArea const &area) {
+    return ImGui::IsWindowHovered() && (!area.state.singleWindow || area.state.mouseNode == -1);
+}
+
+// Single window backend: mouse input only goes to the topmost node under the mouse.
+bool isNodeOccluded(NodeArea const &area, NodeState const &node) {
+    NodeArea::InternalState const &state = area.state;
+    return state.singleWindow && state.mouseNode != -1 && state.mouseNode != node.id && state.activeItemNode != node.id;
+}
+
 } // anonymous namespace
 
 void NodeArea::Selection::clearSelection() {
@@ -482,29 +961,476 @@ void NodeArea::Selection::toggleSelection(int id) {
     }
 }
 
-bool NodeArea::Selection::isSelected(int id) const {
-    if (id >= (int)selectedItems.size()) {
-        return false;
+bool NodeArea::Selection::isSelected(int id) const {
+    if (id >= (int)selectedItems.size()) {
+        return false;
+    }
+    return selectedItems[id];
+}
+
+void NodeArea::SpatialIndex::reset(ImVec2 areaSize, int count) {
+    columns = std::max(1, (int)std::ceil(areaSize.x / cellSize));
+    rows = std::max(1, (int)std::ceil(areaSize.y / cellSize));
+    maxItemSize = ImVec2();
+    cells.assign(columns * rows, std::vector<int>());
+    itemRects.assign(count, ImVec4());
+    itemCell.assign(count, -1);
+    itemSlot.assign(count, -1);
+}
+
+void NodeArea::SpatialIndex::grow(int count) {
+    IM_ASSERT(count >= itemCount());
+    itemRects.resize(count, ImVec4());
+    itemCell.resize(count, -1);
+    itemSlot.resize(count, -1);
+}
+
+void NodeArea::SpatialIndex::update(int item, ImVec4 const &rect) {
+    IM_ASSERT(item >= 0 && item < itemCount());
+    int column = ImClamp((int)(rect.x / cellSize), 0, columns - 1);
+    int row = ImClamp((int)(rect.y / cellSize), 0, rows - 1);
+    int cell = row * columns + column;
+
+    itemRects[item] = rect;
+    maxItemSize.x = std::max(maxItemSize.x, rect.z - rect.x);
+    maxItemSize.y = std::max(maxItemSize.y, rect.w - rect.y);
+
+    if (itemCell[item] == cell) {
+        return;
+    }
+    if (itemCell[item] != -1) {
+        // swap-remove from the old cell
+        std::vector<int> &oldCell = cells[itemCell[item]];
+        int moved = oldCell.back();
+        oldCell[itemSlot[item]] = moved;
+        itemSlot[moved] = itemSlot[item];
+        oldCell.pop_back();
+    }
+    itemCell[item] = cell;
+    itemSlot[item] = (int)cells[cell].size();
+    cells[cell].push_back(item);
+}
+
+void NodeArea::SpatialIndex::remove(int item) {
+    IM_ASSERT(item >= 0 && item < itemCount());
+    itemRects[item] = ImVec4();
+    if (itemCell[item] == -1) {
+        return;
+    }
+    std::vector<int> &oldCell = cells[itemCell[item]];
+    int moved = oldCell.back();
+    oldCell[itemSlot[item]] = moved;
+    itemSlot[moved] = itemSlot[item];
+    oldCell.pop_back();
+    itemCell[item] = -1;
+}
+
+namespace {
+
+// Nodes which were not measured yet or whose measurement is deferred (measureBudgetMs) have no
+// slots until they are drawn.
+bool isNodePending(NodeState const &node) {
+    return node.forceRedraw || node.size.x < 0.f;
+}
+
+ImVec4 emptyBounds() {
+    float max = std::numeric_limits<float>::max();
+    float min = std::numeric_limits<float>::lowest();
+    return ImVec4(max, max, min, min);
+}
+
+ImVec4 mergeBounds(ImVec4 const &a, ImVec4 const &b) {
+    return ImVec4(std::min(a.x, b.x), std::min(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w));
+}
+
+// Moves the node index and graph bounds entries of a geometry table row along with the row.
+void indexGeometryRow(NodeArea::InternalState &state, int id) {
+    NodeArea::GeometryTable const &geometry = state.geometry;
+    ImVec4 rect(geometry.x[id], geometry.y[id], geometry.x[id] + geometry.w[id], geometry.y[id] + geometry.h[id]);
+    if (id < state.nodeIndex.itemCount()) {
+        state.nodeIndex.update(id, rect);
+    }
+    state.graphBounds.update(id, rect);
+}
+
+} // unnamed namespace
+
+void NodeArea::BoundsTree::update(int id, ImVec4 const &rect) {
+    IM_ASSERT(id >= 0);
+    if (id >= leafCount) {
+        int oldCount = leafCount;
+        leafCount = std::max(leafCount, 64);
+        while (leafCount <= id) {
+            leafCount *= 2;
+        }
+        std::vector<ImVec4> grown(2 * leafCount, emptyBounds());
+        std::copy(rects.begin() + oldCount, rects.end(), grown.begin() + leafCount);
+        for (int i = leafCount - 1; i > 0; --i) {
+            grown[i] = mergeBounds(grown[2 * i], grown[2 * i + 1]);
+        }
+        rects.swap(grown);
+    }
+    int i = leafCount + id;
+    if (rects[i] == rect) {
+        return;
+    }
+    rects[i] = rect;
+    if (trackChanges) {
+        changed.push_back(id);
+    }
+    for (i /= 2; i > 0; i /= 2) {
+        ImVec4 merged = mergeBounds(rects[2 * i], rects[2 * i + 1]);
+        if (rects[i] == merged) {
+            break;
+        }
+        rects[i] = merged;
+    }
+}
+
+void NodeArea::BoundsTree::remove(int id) {
+    if (id >= 0 && id < leafCount) {
+        update(id, emptyBounds());
+    }
+}
+
+bool NodeArea::BoundsTree::empty() const {
+    return rects.empty() || rects[1].x > rects[1].z;
+}
+
+NodeArea::Minimap::CellRange NodeArea::Minimap::cellsOf(ImVec4 const &rect) const {
+    CellRange range = { 0, 0, -1, -1 };
+    if (rect.x > rect.z || columns == 0) {
+        return range;
+    }
+    range.minX = ImClamp((int)((rect.x - area.x) / cellSize), 0, columns - 1);
+    range.minY = ImClamp((int)((rect.y - area.y) / cellSize), 0, rows - 1);
+    range.maxX = ImClamp((int)((rect.z - area.x) / cellSize), 0, columns - 1);
+    range.maxY = ImClamp((int)((rect.w - area.y) / cellSize), 0, rows - 1);
+    return range;
+}
+
+void NodeArea::Minimap::rebuild(BoundsTree const &bounds) {
+    ImVec4 graph = bounds.empty() ? ImVec4(0.f, 0.f, 1.f, 1.f) : bounds.bounds();
+    // leave room to grow, so that moving nodes rarely forces a rebuild
+    ImVec2 extent = ImMax(ImVec2(graph.z - graph.x, graph.w - graph.y), ImVec2(64.f, 64.f));
+    ImVec2 margin = extent * 0.25f;
+    area = ImVec4(graph.x - margin.x, graph.y - margin.y, graph.x + extent.x + margin.x, graph.y + extent.y + margin.y);
+    cellSize = std::max(area.z - area.x, area.w - area.y) / (float)resolution;
+    columns = std::max(1, (int)std::ceil((area.z - area.x) / cellSize));
+    rows = std::max(1, (int)std::ceil((area.w - area.y) / cellSize));
+
+    cellNodes.assign(columns * rows, 0);
+    nodeCells.assign(bounds.leafCount, CellRange{ 0, 0, -1, -1 });
+    nodeCenter.assign(bounds.leafCount, -1);
+    links.clear();
+    for (int id = 0; id < bounds.leafCount; ++id) {
+        setNode(id, bounds.rect(id));
+    }
+}
+
+void NodeArea::Minimap::setNode(int id, ImVec4 const &rect) {
+    if (id >= (int)nodeCells.size()) {
+        nodeCells.resize(id + 1, CellRange{ 0, 0, -1, -1 });
+        nodeCenter.resize(id + 1, -1);
+    }
+    CellRange range = cellsOf(rect);
+    CellRange &old = nodeCells[id];
+    if (range.minX != old.minX || range.minY != old.minY || range.maxX != old.maxX || range.maxY != old.maxY) {
+        for (int y = old.minY; y <= old.maxY; ++y) {
+            for (int x = old.minX; x <= old.maxX; ++x) {
+                --cellNodes[y * columns + x];
+            }
+        }
+        for (int y = range.minY; y <= range.maxY; ++y) {
+            for (int x = range.minX; x <= range.maxX; ++x) {
+                ++cellNodes[y * columns + x];
+            }
+        }
+        old = range;
+    }
+
+    int center = -1;
+    if (range.minX <= range.maxX) {
+        CellRange c = cellsOf(ImVec4((rect.x + rect.z) * 0.5f, (rect.y + rect.w) * 0.5f, (rect.x + rect.z) * 0.5f, (rect.y + rect.w) * 0.5f));
+        center = c.minY * columns + c.minX;
+    }
+    if (center != nodeCenter[id]) {
+        std::vector<int> const *attached = id < (int)nodeEdges.size() ? &nodeEdges[id] : nullptr;
+        if (attached) {
+            for (int edge : *attached) {
+                link(edge, -1);
+            }
+        }
+        nodeCenter[id] = center;
+        if (attached) {
+            for (int edge : *attached) {
+                link(edge, +1);
+            }
+        }
+    }
+}
+
+// Adds delta to the link between the center cells of the end nodes of an edge.
+void NodeArea::Minimap::link(int edge, int delta) {
+    Edge const &e = edges[edge];
+    int a = e.source < (int)nodeCenter.size() ? nodeCenter[e.source] : -1;
+    int b = e.sink < (int)nodeCenter.size() ? nodeCenter[e.sink] : -1;
+    if (a < 0 || b < 0 || a == b) {
+        return;
+    }
+    int key = std::min(a, b) * (columns * rows) + std::max(a, b);
+    int &count = links[key];
+    count += delta;
+    if (count <= 0) {
+        links.erase(key);
+    }
+}
+
+namespace {
+
+void detachEdge(NodeArea::Minimap &minimap, int id) {
+    NodeArea::Minimap::Edge &edge = minimap.edges[id];
+    minimap.link(id, -1);
+    for (int node : { edge.source, edge.sink }) {
+        std::vector<int> &attached = minimap.nodeEdges[node];
+        attached.erase(std::find(attached.begin(), attached.end(), id));
+    }
+    edge.source = edge.sink = -1;
+}
+
+} // unnamed namespace
+
+void NodeArea::Minimap::noteEdge(int id, int source, int sink) {
+    if (id < 0 || source < 0 || sink < 0) {
+        return;
+    }
+    if (id >= (int)edges.size()) {
+        edges.resize(id + 1, Edge{ -1, -1, 0 });
+    }
+    Edge &edge = edges[id];
+    edge.lastFrame = frame;
+    if (edge.source == source && edge.sink == sink) {
+        return;
+    }
+    if (edge.source >= 0) {
+        detachEdge(*this, id);
+    }
+    if (std::max(source, sink) >= (int)nodeEdges.size()) {
+        nodeEdges.resize(std::max(source, sink) + 1);
+    }
+    edge.source = source;
+    edge.sink = sink;
+    nodeEdges[source].push_back(id);
+    nodeEdges[sink].push_back(id);
+    link(id, +1);
+}
+
+// Drops edges which were not drawn for a few frames (deleted ones), checking budget edges.
+void NodeArea::Minimap::sweepEdges(int budget) {
+    int count = (int)edges.size();
+    for (int i = 0; i < std::min(budget, count); ++i) {
+        edgeSweep = edgeSweep + 1 < count ? edgeSweep + 1 : 0;
+        if (edges[edgeSweep].source >= 0 && frame - edges[edgeSweep].lastFrame > 2) {
+            detachEdge(*this, edgeSweep);
+        }
+    }
+}
+
+void NodeArea::GeometryTable::set(NodeState const &node) {
+    int id = node.id;
+    if (id < 0) {
+        return;
+    }
+    if (id >= count()) {
+        int size = std::max(id + 1, count() * 2);
+        x.resize(size); y.resize(size);
+        floatX.resize(size); floatY.resize(size);
+        w.resize(size); h.resize(size);
+        flags.resize(size, 0);
+    }
+    x[id] = node.pos.x;
+    y[id] = node.pos.y;
+    floatX[id] = node.posFloat.x;
+    floatY[id] = node.posFloat.y;
+    w[id] = std::max(node.size.x, 0.f);
+    h[id] = std::max(node.size.y, 0.f);
+    flags[id] = (unsigned char)((flags[id] & ~Flag_Moved) | Flag_Alive);
+}
+
+void NodeArea::GeometryTable::remove(int id) {
+    if (id >= 0 && id < count()) {
+        flags[id] = 0;
+    }
+}
+
+void NodeArea::GeometryTable::select(Selection const &selection) {
+    int selected = std::min(count(), (int)selection.selectedItems.size());
+    for (int i = 0; i < selected; ++i) {
+        flags[i] = (unsigned char)((flags[i] & ~Flag_Selected) | (selection.selectedItems[i] ? Flag_Selected : 0));
+    }
+    for (int i = selected; i < count(); ++i) {
+        flags[i] &= (unsigned char)~Flag_Selected;
+    }
+}
+
+// The loops below select with the mask instead of branching, so they vectorize.
+void NodeArea::GeometryTable::translate(unsigned char mask, ImVec2 delta, bool snap, float grid, float offset) {
+    int n = count();
+    float *px = x.data(), *py = y.data(), *fx = floatX.data(), *fy = floatY.data();
+    unsigned char const *f = flags.data();
+    for (int i = 0; i < n; ++i) {
+        bool on = (f[i] & mask) == mask;
+        fx[i] += on ? delta.x : 0.f;
+        fy[i] += on ? delta.y : 0.f;
+    }
+    if (snap) {
+        for (int i = 0; i < n; ++i) {
+            bool on = (f[i] & mask) == mask;
+            px[i] = on ? std::floor(fx[i] / grid) * grid - offset : px[i];
+            py[i] = on ? std::floor(fy[i] / grid) * grid - offset : py[i];
+        }
+    } else {
+        for (int i = 0; i < n; ++i) {
+            bool on = (f[i] & mask) == mask;
+            px[i] = on ? fx[i] : px[i];
+            py[i] = on ? fy[i] : py[i];
+        }
+    }
+}
+
+void NodeArea::GeometryTable::snap(unsigned char mask, float grid, float offset) {
+    int n = count();
+    float *px = x.data(), *py = y.data(), *fx = floatX.data(), *fy = floatY.data();
+    unsigned char const *f = flags.data();
+    for (int i = 0; i < n; ++i) {
+        bool on = (f[i] & mask) == mask;
+        px[i] = on ? std::floor(px[i] / grid) * grid - offset : px[i];
+        py[i] = on ? std::floor(py[i] / grid) * grid - offset : py[i];
+        fx[i] = on ? px[i] : fx[i];
+        fy[i] = on ? py[i] : fy[i];
+    }
+}
+
+void NodeArea::GeometryTable::align(unsigned char mask, Alignment alignment, ImVec4 const &to) {
+    int n = count();
+    bool horizontal = alignment == Alignment::Left || alignment == Alignment::CenterX || alignment == Alignment::Right;
+    // target = base - extent * factor, with extent the node width or height
+    float base, factor;
+    switch (alignment) {
+    case Alignment::Left: base = to.x; factor = 0.f; break;
+    case Alignment::CenterX: base = (to.x + to.z) * 0.5f; factor = 0.5f; break;
+    case Alignment::Right: base = to.z; factor = 1.f; break;
+    case Alignment::Top: base = to.y; factor = 0.f; break;
+    case Alignment::CenterY: base = (to.y + to.w) * 0.5f; factor = 0.5f; break;
+    default: base = to.w; factor = 1.f; break;
+    }
+    float *p = horizontal ? x.data() : y.data();
+    float *fp = horizontal ? floatX.data() : floatY.data();
+    float const *extent = horizontal ? w.data() : h.data();
+    unsigned char const *f = flags.data();
+    for (int i = 0; i < n; ++i) {
+        bool on = (f[i] & mask) == mask;
+        p[i] = on ? base - extent[i] * factor : p[i];
+        fp[i] = on ? p[i] : fp[i];
+    }
+}
+
+void NodeArea::GeometryTable::distribute(unsigned char mask, bool horizontal) {
+    std::vector<int> ids;
+    for (int i = 0; i < count(); ++i) {
+        if ((flags[i] & mask) == mask) {
+            ids.push_back(i);
+        }
+    }
+    if (ids.size() < 3) {
+        return;
+    }
+    std::vector<float> &p = horizontal ? x : y;
+    std::vector<float> &fp = horizontal ? floatX : floatY;
+    std::vector<float> const &extent = horizontal ? w : h;
+    std::stable_sort(ids.begin(), ids.end(), [&](int a, int b) {
+        return p[a] + extent[a] * 0.5f < p[b] + extent[b] * 0.5f;
+    });
+    float total = 0.f;
+    for (int id : ids) {
+        total += extent[id];
+    }
+    float begin = p[ids.front()];
+    float end = p[ids.back()] + extent[ids.back()];
+    float gap = (end - begin - total) / (float)(ids.size() - 1);
+    float cursor = begin;
+    for (int id : ids) {
+        fp[id] = p[id] = cursor;
+        cursor += extent[id] + gap;
+    }
+}
+
+bool NodeArea::GeometryTable::bounds(unsigned char mask, ImVec4 &result) const {
+    const float maxValue = std::numeric_limits<float>::max();
+    float minX = maxValue, minY = maxValue, maxX = -maxValue, maxY = -maxValue;
+    int n = count();
+    for (int i = 0; i < n; ++i) {
+        bool on = (flags[i] & mask) == mask;
+        minX = std::min(minX, on ? x[i] : maxValue);
+        minY = std::min(minY, on ? y[i] : maxValue);
+        maxX = std::max(maxX, on ? x[i] + w[i] : -maxValue);
+        maxY = std::max(maxY, on ? y[i] + h[i] : -maxValue);
+    }
+    result = ImVec4(minX, minY, maxX, maxY);
+    return minX <= maxX;
+}
+
+void NodeArea::GeometryTable::query(ImVec4 const &rect, std::vector<int> &result) const {
+    int n = count();
+    for (int i = 0; i < n; ++i) {
+        bool overlaps = (flags[i] & Flag_Alive) &&
+            x[i] <= rect.z && x[i] + w[i] >= rect.x &&
+            y[i] <= rect.w && y[i] + h[i] >= rect.y;
+        if (overlaps) {
+            result.push_back(i);
+        }
+    }
+}
+
+void NodeArea::SpatialIndex::query(ImVec4 const &rect, std::vector<int> &result) const {
+    ImRect queryRect(rect);
+    int minColumn = ImClamp((int)((rect.x - maxItemSize.x) / cellSize), 0, columns - 1);
+    int minRow    = ImClamp((int)((rect.y - maxItemSize.y) / cellSize), 0, rows - 1);
+    int maxColumn = ImClamp((int)(rect.z / cellSize), 0, columns - 1);
+    int maxRow    = ImClamp((int)(rect.w / cellSize), 0, rows - 1);
+
+    for (int row = minRow; row <= maxRow; ++row) {
+        for (int column = minColumn; column <= maxColumn; ++column) {
+            for (int item : cells[row * columns + column]) {
+                if (queryRect.Overlaps(ImRect(itemRects[item]))) {
+                    result.push_back(item);
+                }
+            }
+        }
     }
-    return selectedItems[id];
 }
 
-void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, NodeAreaFlags flags) {
+bool NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, NodeAreaFlags flags) {
     bool setWindowPos = false;
 
-    if (state.flags & NodeAreaFlags_ZoomToFit) {
-        if (state.lowerBound.x != std::numeric_limits<float>::max()) {
-            ImVec2 extent = state.upperBound - state.lowerBound;
-            ImVec2 factor = ImGui::GetWindowSize() / extent;
-            state.zoom = std::max(std::min(std::min(factor.x, factor.y) * 0.95f, 1.f), state.zoomLimits.x);
-            state.innerWndPos = -state.lowerBound + (ImGui::GetWindowSize() / 2.f) / state.zoom - extent / 2.f;
-            setWindowPos = true;
-        } else {
-            state.zoom = 1.f;
-            state.innerWndPos = -state.nodeAreaSize / 2.f + ImGui::GetWindowSize() / 2.f;
-            setWindowPos = true;
-        }
+    if (state.mutationQueue) {
+        // before the idle check: applied mutations invalidate the node area
+        state.mutationQueue->drain(*this, state.mutationBudget);
+    }
+
+    if (state.recorder) {
+        state.recorder->record(*this, ImGui::GetWindowPos(), ImGui::GetWindowSize(), flags);
+    }
+
+    state.idleFrame = false;
+    if (state.skipIdleFrames && state.initialized && isIdleFrame(*this, flags)) {
+        state.outerContext = ImGui::GetCurrentContext();
+        state.idleFrame = true;
+        return false;
     }
+    state.invalidated = false;
+    state.lastOuterWindowPos = ImGui::GetWindowPos();
+    state.lastOuterWindowSize = ImGui::GetWindowSize();
 
     state.flags = flags;
     state.outerContext = ImGui::GetCurrentContext();
@@ -520,13 +1446,18 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
     if (state.flags & NodeAreaFlags_UpdateStyle) {
         state.innerContext->Style = state.outerContext->Style;
     }
+    if (state.viewRequested) {
+        state.zoom = ImClamp(state.requestedZoom, state.zoomLimits.x, state.zoomLimits.y);
+        state.innerWndPos = state.requestedWndPos;
+        state.viewRequested = false;
+        setWindowPos = true;
+    }
 
 #ifdef IMGUI_NODES_DEBUG
     debug.str("");
     debug.clear();
 #endif
 
-    ImVec2 windowSize = ImGui::GetWindowSize() / state.zoom;
     ImVec2 windowPos = ImGui::GetWindowPos();
     ImGuiIO& outerIo = ImGui::GetIO();
     bool outerWindowHovered = ImGui::IsWindowHovered();
@@ -540,12 +1471,28 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
     }
 
     state.outerWindowFocused = ImGui::IsWindowFocused();
-    state.outerWindowHovered = ImGui::IsWindowHovered();
+    state.outerWindowHovered = ImGui::IsWindowHovered() && !state.minimap.capturesMouse;
 
     if (state.outerWindowFocused && state.hoveredNode == -1 && !state.anyItemActive && ImGui::IsKeyReleased(ImGuiKey_Home)) {
         state.flags |= NodeAreaFlags_ZoomToFit;
     }
 
+    // the bounds are maintained as nodes change, so the zoom applies to this frame already
+    if (state.flags & NodeAreaFlags_ZoomToFit) {
+        ImVec2 lowerBound, upperBound;
+        if (GetGraphBounds(&lowerBound, &upperBound)) {
+            ImVec2 extent = ImMax(upperBound - lowerBound, ImVec2(1.f, 1.f));
+            ImVec2 factor = ImGui::GetWindowSize() / extent;
+            state.zoom = std::max(std::min(std::min(factor.x, factor.y) * 0.95f, 1.f), state.zoomLimits.x);
+            state.innerWndPos = -lowerBound + (ImGui::GetWindowSize() / 2.f) / state.zoom - extent / 2.f;
+            setWindowPos = true;
+        } else {
+            state.zoom = 1.f;
+            state.innerWndPos = -state.nodeAreaSize / 2.f + ImGui::GetWindowSize() / 2.f;
+            setWindowPos = true;
+        }
+    }
+
     if (state.outerWindowHovered && state.hoveredNode == -1 && outerIo.MouseWheel != 0.f && state.innerContext->OpenPopupStack.empty()) {
         const float factor = 1.25f;
         float newZoom = outerIo.MouseWheel > 0 ? (state.zoom * factor) : (state.zoom / factor);
@@ -558,10 +1505,20 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
         }
     }
 
+    ImVec2 windowSize = ImGui::GetWindowSize() / state.zoom;
+    if (state.allocator) {
+        state.allocator->resetFrame();
+        state.allocator->install();
+    }
     ImGui::SetCurrentContext(state.innerContext);
 
     innerContextNewFrame(state.outerContext, state.innerContext, state.zoom,
-        outerIo, windowSize, windowPos, state.outerWindowFocused, state.outerWindowHovered);
+        outerIo, windowSize, windowPos, state.outerWindowFocused && !state.minimap.capturesMouse, state.outerWindowHovered);
+    applyZoomFont(state.zoomFonts, state.innerContext, state.zoom);
+
+    if (!state.singleWindow) {
+        collectNodeWindows(*this);
+    }
 
     ImGui::NewFrame();
 #ifdef IMGUI_NODES_DEBUG
@@ -711,6 +1668,31 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
 
     paintGrid(style);
 
+    if (state.singleWindow) {
+        // grid and edges stay in channel 0, nodes are drawn above them into channel 1
+        if (!state.nodeChannels) {
+            // the channel buffers grow while the allocator is installed, so they have to be
+            // released with it installed, too. Holding it keeps its pools alive until then.
+            std::shared_ptr<NodeAllocator> allocator = state.allocator;
+            state.nodeChannels = std::shared_ptr<ImDrawListSplitter>(new ImDrawListSplitter(), [allocator](ImDrawListSplitter *splitter) {
+                bool install = allocator && !allocator->installed();
+                if (install) {
+                    allocator->install();
+                }
+                delete splitter;
+                if (install) {
+                    allocator->uninstall();
+                }
+            });
+        }
+        state.nodeChannels->Split(ImGui::GetWindowDrawList(), 2);
+        state.nodeChannels->SetCurrentChannel(ImGui::GetWindowDrawList(), 1);
+        state.mouseNode = state.nextMouseNode;
+        state.activeItemNode = state.nextActiveItemNode;
+        state.nextMouseNode = -1;
+        state.nextActiveItemNode = -1;
+    }
+
     state.activeNode = -1;
     state.hoveredNode = -1;
     state.hoveredEdge = -1;
@@ -718,11 +1700,30 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
     state.edgeEndSlot = -1;
     state.anySizeChanged = false;
 
-    if (state.flags & NodeAreaFlags_ZoomToFit) {
-        float max = std::numeric_limits<float>::max();
-        float min = std::numeric_limits<float>::lowest();
-        state.lowerBound = ImVec2(max, max);
-        state.upperBound = ImVec2(min, min);
+    state.dirtyRects.swap(state.pendingDirtyRects);
+    state.pendingDirtyRects.clear();
+    ++state.measureFrame;
+    state.measureSpentMs = 0.f;
+
+    if (state.useGeometryTable) {
+        // moves of all dragged nodes at once, EndNode copies them into the NodeStates
+        GeometryTable &geometry = state.geometry;
+        ImVec2 mouseDelta = ImGui::GetIO().MouseDelta;
+        if (state.mode == Mode::DraggingNodes && mouseDelta != ImVec2()) {
+            const unsigned char dragged = GeometryTable::Flag_Alive | GeometryTable::Flag_Selected;
+            geometry.select(state.selectedNodes);
+            geometry.translate(dragged, mouseDelta, !ImGui::GetIO().KeyShift, state.snapGrid, style[Style_EdgeSize]);
+            // nodes not submitted during the drag pick up their move whenever they are submitted next
+            for (int id = 0; id < geometry.count(); ++id) {
+                if ((geometry.flags[id] & dragged) == dragged) {
+                    geometry.flags[id] |= GeometryTable::Flag_Moved;
+                    indexGeometryRow(state, id);
+                }
+            }
+        }
+        if (state.flags & NodeAreaFlags_SnapToGrid) {
+            geometry.snap(GeometryTable::Flag_Alive, state.snapGrid, style[Style_EdgeSize]);
+        }
     }
 
 #ifdef IMGUI_NODES_DEBUG
@@ -734,9 +1735,19 @@ void NodeArea::BeginNodeArea(std::function<void(UserAction)> actionCallback, Nod
         << " hovered " << ImGui::IsWindowHovered()
         << std::endl;
 #endif
+    return true;
 }
 
 void NodeArea::EndNodeArea() {
+    if (state.idleFrame) {
+        emitInnerDrawData(*this, state.lastDrawData);
+        return;
+    }
+
+    if (state.measureBudgetMs > 0.f) {
+        scheduleMeasurements(*this);
+    }
+
 #ifdef IMGUI_NODES_DEBUG
     debug << "EndNodeArea " << ImGui::IsAnyItemActive() << " " << state.anySizeChanged << std::endl;
 #endif
@@ -765,20 +1776,9 @@ void NodeArea::EndNodeArea() {
         break;
     }
 
-    if (state.mode == Mode::Selecting)
-    {
-        ImDrawList *draw_list = ImGui::GetWindowDrawList();
-        ImVec2 offset = ImGui::GetWindowPos();
-        if (state.dragStart != state.dragEnd) {
-            draw_list->AddRectFilled(offset + state.dragStart, offset + state.dragEnd, style[Style_SelectionFill]);
-            draw_list->AddRect(offset + state.dragStart, offset + state.dragEnd, style[Style_SelectionBorder]);
-        }
-    }
-
     if (state.mode == Mode::DraggingEdgeInput ||
         state.mode == Mode::DraggingEdgeOutput)
     {
-        ImDrawList *draw_list = ImGui::GetWindowDrawList();
         ImVec2 offset = ImGui::GetWindowPos();
 
         ImVec2 p1 = offset + (state.mode == Mode::DraggingEdgeInput ? state.dragStart : state.dragEnd);
@@ -786,7 +1786,27 @@ void NodeArea::EndNodeArea() {
         ImVec2 p2 = offset + (state.mode == Mode::DraggingEdgeInput ? state.dragEnd : state.dragStart);
         ImVec2 cp2 = p2 + ImVec2(-50, 0);
 
-        draw_list->AddBezierCubic(p1, cp1, cp2, p2, style[Style_EdgeDragging], style[Style_EdgeDraggingSize]);
+        addEdgeStroke(*this, EdgeLayer_Dragging, p1, cp1, cp2, p2, style[Style_EdgeDragging], style[Style_EdgeDraggingSize]);
+    }
+
+    if (state.singleWindow) {
+        state.nodeChannels->SetCurrentChannel(ImGui::GetWindowDrawList(), 0);
+    }
+
+    flushEdgeLayers(*this);
+
+    if (state.mode == Mode::Selecting)
+    {
+        ImDrawList *draw_list = ImGui::GetWindowDrawList();
+        ImVec2 offset = ImGui::GetWindowPos();
+        if (state.dragStart != state.dragEnd) {
+            draw_list->AddRectFilled(offset + state.dragStart, offset + state.dragEnd, style[Style_SelectionFill]);
+            draw_list->AddRect(offset + state.dragStart, offset + state.dragEnd, style[Style_SelectionBorder]);
+        }
+    }
+
+    if (state.singleWindow) {
+        state.nodeChannels->Merge(ImGui::GetWindowDrawList());
     }
 
     state.anyItemActive = ImGui::IsAnyItemActive();
@@ -798,6 +1818,9 @@ void NodeArea::EndNodeArea() {
     IM_ASSERT(innerDrawData->Valid);
 
     ImGui::SetCurrentContext(state.outerContext);
+    if (state.allocator) {
+        state.allocator->uninstall();
+    }
 
     if (state.outerWindowHovered) {
         state.outerContext->MouseCursor = state.innerContext->MouseCursor;
@@ -806,19 +1829,8 @@ void NodeArea::EndNodeArea() {
         }
     }
 
-    // ImGui snaps geometry to whole pixels. This leads to jaggy movement when zooming in.
-    // We fix this by translating by the fract of the exact position.
-    // This is also why we push a one pixel bigger clip-rect than usually necessary.
-    ImVec2 fractInnerWndPos(
-        floor(fmodf(state.innerWndPos.x, 1.f) * state.zoom),
-        floor(fmodf(state.innerWndPos.y, 1.f) * state.zoom));
-
-    ImVec2 translate = state.outerContext->CurrentWindow->Pos + fractInnerWndPos;
-    float scale = state.zoom;
-
-    if ((state.flags & NodeAreaFlags_NoCopy) == 0) {
-        copyTransformDrawCmds(innerDrawData, scale, translate);
-    }
+    state.lastDrawData = innerDrawData;
+    emitInnerDrawData(*this, innerDrawData);
 
 #ifdef IMGUI_NODES_DEBUG
     debug << "active node " << state.activeNode << std::endl;
@@ -833,69 +1845,102 @@ bool NodeArea::BeginNode(NodeState &node, bool resizeable) {
     node.skip = false;
 
     node.forceRedraw = node.forceRedraw || node.size.x < 0.0f || state.flags & NodeAreaFlags_ForceRedraw;
+    if (!node.forceRedraw && !state.dirtyRects.empty()) {
+        node.forceRedraw = overlapsDirtyRect(*this, node);
+    }
 
-    if (!node.forceRedraw) {
+    bool deferred = false;
+    bool amortize = state.measureBudgetMs > 0.f && node.id >= 0;
+    if (!node.forceRedraw || amortize) {
         ImVec2 origin = state.innerWndPos + node.pos;
-        ImVec2 originAndSize = origin + node.size + style[Style_NodePadding] * 2.f + style[Style_SlotRadius] * 2.f;
+        ImVec2 originAndSize = origin + ImMax(node.size, ImVec2()) + style[Style_NodePadding] * 2.f + style[Style_SlotRadius] * 2.f;
         ImRect clip(origin, originAndSize);
 
         ImDrawList* draw_list = ImGui::GetWindowDrawList();
         ImVec4 windowClipRect = draw_list->_ClipRectStack[draw_list->_ClipRectStack.size() - 1];
 
         node.skip = !clip.Overlaps(windowClipRect);
+        if (node.forceRedraw && node.skip) {
+            // offscreen redraw: measured now only if granted and the budget of this frame allows
+            bool granted = node.id < (int)state.measureGrant.size() && state.measureGrant[node.id] == state.measureFrame;
+            if (granted && state.measureSpentMs < state.measureBudgetMs) {
+                node.skip = false;
+                state.measureStart = measureClockMs();
+            } else {
+                float dx = std::max(std::max(windowClipRect.x - clip.Max.x, clip.Min.x - windowClipRect.z), 0.f);
+                float dy = std::max(std::max(windowClipRect.y - clip.Max.y, clip.Min.y - windowClipRect.w), 0.f);
+                state.measureCandidates.push_back(std::make_pair(dx * dx + dy * dy, node.id));
+                deferred = true;
+            }
+        }
     }
 
-    char buf[64];
+    node.sizeConstraintMin = state.innerContext->NextWindowData.SizeConstraintRect.Min;
+    node.sizeConstraintMax = state.innerContext->NextWindowData.SizeConstraintRect.Max;
+
+    if (state.singleWindow || node.skip) {
+        // culled nodes do not begin their window, so it can be collected after a while; there is
+        // no node window to consume the size constraints
+        state.innerContext->NextWindowData.ClearFlags();
+    } else {
+        char buf[64];
 #ifdef _MSC_VER
-    sprintf_s(buf, "##node%d", node.id);
+        sprintf_s(buf, "##node%d", node.id);
 #else
-    sprintf(buf, "##node%d", node.id);
+        sprintf(buf, "##node%d", node.id);
 #endif
-    node.sizeConstraintMin = state.innerContext->NextWindowData.SizeConstraintRect.Min;
-    node.sizeConstraintMax = state.innerContext->NextWindowData.SizeConstraintRect.Max;
+        ImGui::SetNextWindowPos(state.innerWndPos + node.pos);
 
-    ImGui::SetNextWindowPos(state.innerWndPos + node.pos);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, style[Style_NodePadding] + ImVec2(style[Style_SlotRadius], 0));
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.f);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.f);
 
-    ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, style[Style_NodePadding] + ImVec2(style[Style_SlotRadius], 0));
-    ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.f);
-    ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 0.f);
+        if (oldSkip && !node.skip && node.size.x >= 0.f) {
+            ImGui::SetNextWindowSize(node.size);
+        }
 
-    if (oldSkip && !node.skip) {
-        ImGui::SetNextWindowSize(node.size);
+        // Overriding the WorkSize is a workaround to keep ImGui::CalcWindowAutoFitSize
+        // from downsizing our nodes if they do not fit our "virtual screen".
+        ImVec2 oldWorkSize = ImGui::GetMainViewport()->WorkSize;
+        ImGui::GetMainViewport()->WorkSize = ImVec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+
+        int wndFlags =
+            ImGuiWindowFlags_AlwaysAutoResize |
+            ImGuiWindowFlags_NoResize |
+            ImGuiWindowFlags_NoMove |
+            ImGuiWindowFlags_NoTitleBar |
+            ImGuiWindowFlags_NoScrollbar |
+            ImGuiWindowFlags_NoScrollWithMouse |
+            ImGuiWindowFlags_NoCollapse |
+            ImGuiWindowFlags_NoSavedSettings |
+            // culled nodes skip Begin, so their windows appear again when scrolled into view or
+            // measured; that must neither reorder them nor steal the active item of another node
+            ImGuiWindowFlags_NoFocusOnAppearing |
+            ImGuiWindowFlags_NoNavFocus;
+
+        // put nodes into a separate "child" window so we can paint them on top of edges
+        ImGui::Begin(buf, nullptr, wndFlags);
+
+        // restore WorkSize
+        ImGui::GetMainViewport()->WorkSize = oldWorkSize;
     }
 
-    // Overriding the WorkSize is a workaround to keep ImGui::CalcWindowAutoFitSize
-    // from downsizing our nodes if they do not fit our "virtual screen".
-    ImVec2 oldWorkSize = ImGui::GetMainViewport()->WorkSize;
-    ImGui::GetMainViewport()->WorkSize = ImVec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-
-    int wndFlags =
-        ImGuiWindowFlags_AlwaysAutoResize |
-        ImGuiWindowFlags_NoResize |
-        ImGuiWindowFlags_NoMove |
-        ImGuiWindowFlags_NoTitleBar |
-        ImGuiWindowFlags_NoScrollbar |
-        ImGuiWindowFlags_NoScrollWithMouse |
-        ImGuiWindowFlags_NoCollapse |
-        ImGuiWindowFlags_NoSavedSettings;
-
-    // put nodes into a separate "child" window so we can paint them on top of edges
-    ImGui::Begin(buf, nullptr, wndFlags);
-
-    // restore WorkSize
-    ImGui::GetMainViewport()->WorkSize = oldWorkSize;
-
-    ImRect visibleArea = getVisibleNodeArea(style);
+    ImRect visibleArea = getVisibleNodeArea(*this, node);
 
     ImGui::PushID(&node);
 
-    if (node.skip && !node.forceRedraw) {
+    if (deferred || (node.skip && !node.forceRedraw)) {
         return false;
     }
     node.forceRedraw = false;
     node.inputSlots.resize(0);
     node.outputSlots.resize(0);
 
+    if (isNodeOccluded(*this, node)) {
+        ImGui::PushItemFlag(ImGuiItemFlags_Disabled, true);
+    }
+    state.nodeActiveIdAlive = state.innerContext->ActiveIdIsAlive;
+
     bool hovered = state.hoveredNode == node.id;
     bool selected = state.selectedNodes.isSelected(node.id);
     ImRect selectionRect(visibleArea.Min, visibleArea.Max);
@@ -906,7 +1951,7 @@ bool NodeArea::BeginNode(NodeState &node, bool resizeable) {
     ImU32 nodeBorder = (selected || wouldSelect) ? style[Style_NodeBorderSelected] : style[Style_NodeBorder];
 
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
-    draw_list->PushClipRect(state.innerWndPos + node.pos, state.innerWndPos + node.pos + ImGui::GetWindowSize());
+    draw_list->PushClipRect(getNodeFramePos(*this, node), getNodeFramePos(*this, node) + getNodeFrameSize(*this, node));
 
     // Draw the node outlines inside the imgui window
     draw_list->AddRectFilled(visibleArea.Min, visibleArea.Max, nodeBg, style[Style_NodeRounding]);
@@ -924,6 +1969,10 @@ bool NodeArea::BeginNode(NodeState &node, bool resizeable) {
         ImU32 resize_col = ImGui::GetColorU32(resizeHeld ? ImGuiCol_ResizeGripActive : resizeHovered ? ImGuiCol_ResizeGripHovered : ImGuiCol_ResizeGrip);
 
         if (resizeHeld && (state.mode == Mode::None || state.mode == Mode::ResizingNode)) {
+            if (state.mode == Mode::None) {
+                state.resizeNode = node.id;
+                state.resizeStartSize = node.size;
+            }
             state.mode = Mode::ResizingNode;
             node.size += ImGui::GetIO().MouseDelta;
 
@@ -946,7 +1995,7 @@ bool NodeArea::BeginNode(NodeState &node, bool resizeable) {
 
     draw_list->PopClipRect();
 
-    ImGui::SetCursorPos(style[Style_NodePadding] + ImVec2(style[Style_SlotRadius], 0));
+    setNodeCursorPos(*this, node, style[Style_NodePadding] + ImVec2(style[Style_SlotRadius], 0));
 
     ImGui::BeginGroup(); // Lock horizontal position
 
@@ -963,13 +2012,17 @@ void NodeArea::EndNode(NodeState &node) {
 #ifdef IMGUI_NODES_DEBUG
         debug << "EndNode " << node.id << " " << ImGui::IsAnyItemActive() << std::endl;
 #endif
-        ImRect visibleArea = getVisibleNodeArea(style);
+        ImRect visibleArea = getVisibleNodeArea(*this, node);
         ImVec2 visibleOffset = getVisibleNodeRelativeOffset(style);
 
         ImGui::EndGroup();
 
         if (state.mode != Mode::ResizingNode) {
-            ImVec2 newSize = ImGui::GetCurrentWindowRead()->ContentSizeIdeal + ImVec2(style[Style_SlotRadius] * 2, 0) + style[Style_NodePadding] * 2;
+            // the node window fits its contents, without it the group bounds are the contents
+            ImVec2 contentSize = state.singleWindow
+                ? ImGui::GetItemRectMax() - getNodeFramePos(*this, node) - style[Style_NodePadding] - ImVec2(style[Style_SlotRadius], 0)
+                : ImGui::GetCurrentWindowRead()->ContentSizeIdeal;
+            ImVec2 newSize = contentSize + ImVec2(style[Style_SlotRadius] * 2, 0) + style[Style_NodePadding] * 2;
 
             // The dampening on the size adaptation fixes possible feedback loops
             // with automatically resizing UI controls and automatically resizing nodes.
@@ -993,7 +2046,7 @@ void NodeArea::EndNode(NodeState &node) {
             }
         }
 
-        ImGui::SetCursorPos(visibleOffset);
+        setNodeCursorPos(*this, node, visibleOffset);
         invisibleButtonNoResize("node", visibleArea.GetSize());
         bool itemActive = state.outerWindowFocused && ImGui::IsItemActive();
         bool itemWasActive = state.outerWindowFocused && WasItemActive();
@@ -1019,6 +2072,22 @@ void NodeArea::EndNode(NodeState &node) {
         if (hovered) {
             state.hoveredNode = node.id;
         }
+
+        if (state.singleWindow) {
+            if (isNodeOccluded(*this, node)) {
+                ImGui::PopItemFlag();
+            }
+            // nodes submitted later are painted on top
+            ImVec2 framePos = getNodeFramePos(*this, node);
+            if (state.outerWindowHovered && ImRect(framePos, framePos + getNodeFrameSize(*this, node)).Contains(ImGui::GetMousePos())) {
+                state.nextMouseNode = node.id;
+            }
+            // an item of this node kept the active id alive
+            ImGuiContext const &g = *state.innerContext;
+            if (g.ActiveId != 0 && g.ActiveIdIsAlive == g.ActiveId && state.nodeActiveIdAlive != g.ActiveId) {
+                state.nextActiveItemNode = node.id;
+            }
+        }
     }
     if (state.mode == Mode::SelectAll) {
         state.selectedNodes.addToSelection(node.id);
@@ -1026,7 +2095,18 @@ void NodeArea::EndNode(NodeState &node) {
     selected = state.selectedNodes.isSelected(node.id);
 
     bool canMove = selected || (hovered && state.mode == Mode::None);
-    if (state.mode == Mode::DraggingNodes && canMove && ImGui::GetIO().MouseDelta != ImVec2()) {
+    bool fromTable = state.useGeometryTable && state.geometry.contains(node.id);
+    bool movedByTable = fromTable && (state.geometry.flags[node.id] & GeometryTable::Flag_Moved);
+    if (fromTable && (movedByTable || state.mode == Mode::DraggingNodes || (state.flags & NodeAreaFlags_SnapToGrid))) {
+        // moved by the geometry table in BeginNodeArea
+        GeometryTable const &geometry = state.geometry;
+        ImVec2 pos(geometry.x[node.id], geometry.y[node.id]);
+        node.posFloat = ImVec2(geometry.floatX[node.id], geometry.floatY[node.id]);
+        if (pos != node.pos) {
+            node.pos = pos;
+            node.forceRedraw = true;
+        }
+    } else if (state.mode == Mode::DraggingNodes && canMove && ImGui::GetIO().MouseDelta != ImVec2()) {
         node.posFloat = node.posFloat + ImGui::GetIO().MouseDelta;
         if (ImGui::GetIO().KeyShift) {
             node.pos = node.posFloat;
@@ -1040,33 +2120,104 @@ void NodeArea::EndNode(NodeState &node) {
     } else if (state.mode == Mode::None) {
         node.posFloat = node.pos;
     }
-    if (state.flags & NodeAreaFlags_SnapToGrid) {
-        node.posFloat = node.pos = ImVec2(
+    if ((state.flags & NodeAreaFlags_SnapToGrid) && !fromTable) {
+        ImVec2 snapped = ImVec2(
             floor((node.pos.x) / state.snapGrid) * state.snapGrid,
             floor((node.pos.y) / state.snapGrid) * state.snapGrid
         ) - style[Style_EdgeSize];
-        node.forceRedraw = true;
+        if (snapped != node.pos) {
+            node.forceRedraw = true;
+        }
+        node.posFloat = node.pos = snapped;
     }
-    if (state.flags & NodeAreaFlags_ZoomToFit) {
-        ImRect r(state.lowerBound, state.upperBound);
-        r.Add(node.pos);
-        r.Add(node.pos + node.size);
-        state.lowerBound = r.Min;
-        state.upperBound = r.Max;
+    ImVec2 max = node.pos + ImMax(node.size, ImVec2());
+    state.graphBounds.update(node.id, ImVec4(node.pos.x, node.pos.y, max.x, max.y));
+    if (state.useGeometryTable) {
+        state.geometry.set(node);
     }
     ImGui::PopID();
-    ImGui::End();
-    ImGui::PopStyleVar(3);
+    if (!state.singleWindow && !node.skip) {
+        ImGui::End();
+        ImGui::PopStyleVar(3);
+    }
+    if (state.measureStart >= 0.0) {
+        float elapsed = (float)(measureClockMs() - state.measureStart);
+        state.measureSpentMs += elapsed;
+        state.measureCostMs = state.measureCostMs * 0.9f + elapsed * 0.1f;
+        state.measureStart = -1.0;
+    }
+}
+
+void NodeArea::SubmitNodes(NodeProvider const &provider) {
+    int count = provider.count();
+    int indexed = state.nodeIndex.itemCount();
+    if (count < indexed || state.nodeIndex.cells.empty()) {
+        for (int i = count; i < indexed; ++i) {
+            state.graphBounds.remove(i);
+        }
+        state.nodeIndex.reset(state.nodeAreaSize, count);
+        indexed = 0;
+    } else if (count > indexed) {
+        state.nodeIndex.grow(count);
+    }
+    for (int i = indexed; i < count; ++i) {
+        ImVec4 rect = provider.rect(i);
+        state.nodeIndex.update(i, rect);
+        state.graphBounds.update(i, rect);
+    }
+
+    // visible area in node area coordinates
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    ImRect visible(draw_list->_ClipRectStack.back());
+    visible.Translate(-state.innerWndPos);
+
+    std::vector<int> &submit = state.submitList;
+    submit.clear();
+    state.nodeIndex.query(ImVec4(visible.Min.x, visible.Min.y, visible.Max.x, visible.Max.y), submit);
+
+    if (state.mode == Mode::SelectAll) {
+        for (int i = 0; i < count; ++i) {
+            state.selectedNodes.addToSelection(i);
+        }
+    }
+    if (state.selectedNodes.selectedCount > 0) {
+        int selectionSize = std::min(count, (int)state.selectedNodes.selectedItems.size());
+        for (int i = 0; i < selectionSize; ++i) {
+            if (state.selectedNodes.selectedItems[i]) {
+                submit.push_back(i);
+            }
+        }
+    }
+    // keep the slots of the node an edge is dragged from alive
+    if ((state.mode == Mode::DraggingEdgeInput || state.mode == Mode::DraggingEdgeOutput) &&
+        state.edgeStartNode >= 0 && state.edgeStartNode < count)
+    {
+        submit.push_back(state.edgeStartNode);
+    }
+
+    // submit in index order to keep the paint order of overlapping nodes stable
+    std::sort(submit.begin(), submit.end());
+    submit.erase(std::unique(submit.begin(), submit.end()), submit.end());
+
+    for (int i : submit) {
+        provider.draw(*this, i);
+    }
+
+    // only submitted nodes can have been moved or resized by the node area
+    for (int i : submit) {
+        state.nodeIndex.update(i, provider.rect(i));
+    }
 }
 
 void NodeArea::BeginSlot(NodeState &node) {
-    ImRect visibleArea = getVisibleNodeArea(style);
+    ImRect visibleArea = getVisibleNodeArea(*this, node);
     ImVec2 visibleOffset = getVisibleNodeRelativeOffset(style);
+    ImVec2 framePos = getNodeFramePos(*this, node);
 
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
-    draw_list->PushClipRect(state.innerWndPos + node.pos, state.innerWndPos + node.pos + ImGui::GetWindowSize());
-    node.lastCursor = ImGui::GetCursorPos();
-    ImVec2 pos = ImGui::GetWindowPos() + ImVec2(visibleOffset.x, node.lastCursor.y);
+    draw_list->PushClipRect(framePos, framePos + getNodeFrameSize(*this, node));
+    node.lastCursor = getNodeCursorPos(*this, node);
+    ImVec2 pos = framePos + ImVec2(visibleOffset.x, node.lastCursor.y);
     draw_list->AddLine(
         pos + ImVec2(0.5f, 0),
         pos + ImVec2(visibleArea.GetSize().x - 1, 0),
@@ -1077,13 +2228,15 @@ void NodeArea::BeginSlot(NodeState &node) {
 
 void NodeArea::EndSlot(NodeState &node, int inputType, int outputType) {
     ImVec2 visibleOffset = getVisibleNodeRelativeOffset(style);
-    ImRect visibleArea = getVisibleNodeArea(style);
+    ImRect visibleArea = getVisibleNodeArea(*this, node);
+    ImVec2 offset = getNodeFramePos(*this, node);
+    ImVec2 cursor = getNodeCursorPos(*this, node);
 
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
-    draw_list->PushClipRect(state.innerWndPos + node.pos, state.innerWndPos + node.pos + ImGui::GetWindowSize());
+    draw_list->PushClipRect(offset, offset + getNodeFrameSize(*this, node));
 
     // relative to visible area
-    float relativeYoffset = node.lastCursor.y + (ImGui::GetCursorPos().y - node.lastCursor.y) / 2.f;
+    float relativeYoffset = node.lastCursor.y + (cursor.y - node.lastCursor.y) / 2.f;
     ImVec2 relativeInputPos  = ImVec2(0.5f, relativeYoffset);
     ImVec2 relativeOutputPos = ImVec2(visibleArea.GetSize().x - 0.5f, relativeYoffset);
 
@@ -1091,8 +2244,7 @@ void NodeArea::EndSlot(NodeState &node, int inputType, int outputType) {
     ImVec2 absoluteOutputPos = relativeOutputPos + node.pos + visibleOffset;
 
     ImVec2 slotBoundsMin = ImVec2(visibleOffset.x, node.lastCursor.y) + style[Style_SlotSeparatorSize];
-    ImVec2 slotBoundsMax = ImVec2(visibleOffset.x + visibleArea.GetSize().x, ImGui::GetCursorPos().y) - ImVec2(style[Style_SlotSeparatorSize], 0);
-    ImVec2 offset = ImGui::GetWindowPos();
+    ImVec2 slotBoundsMax = ImVec2(visibleOffset.x + visibleArea.GetSize().x, cursor.y) - ImVec2(style[Style_SlotSeparatorSize], 0);
 
     auto paintEdgeDock = [&](ImVec2 pos, ImColor col, bool input, int slotIdx, ImVec2 dragPos) {
 #ifdef IMGUI_NODES_DEBUG
@@ -1102,7 +2254,7 @@ void NodeArea::EndSlot(NodeState &node, int inputType, int outputType) {
 #endif
         draw_list->AddCircleFilled(visibleArea.Min + pos, style[Style_SlotRadius], col);
 
-        bool hovered = state.outerWindowFocused;
+        bool hovered = state.outerWindowFocused && !isNodeOccluded(*this, node);
 
         // Is circle dot hovered?
         hovered = hovered &&
@@ -1112,12 +2264,12 @@ void NodeArea::EndSlot(NodeState &node, int inputType, int outputType) {
         if (style.newEdgeFromSlot) {
             anotherItemIsActive = ImGui::IsAnyItemActive();
 
-            ImVec2 oldCursor = ImGui::GetCursorPos();
+            ImVec2 oldCursor = ImGui::GetCursorScreenPos();
             bool oldIsSetPos = ImGui::GetCurrentWindow()->DC.IsSetPos;
             ImVec2 oldMaxPos = ImGui::GetCurrentWindow()->DC.CursorMaxPos;
-            ImGui::SetCursorPos(slotBoundsMin);
+            setNodeCursorPos(*this, node, slotBoundsMin);
             invisibleButtonNoResize("slot", slotBoundsMax - slotBoundsMin);
-            ImGui::SetCursorPos(oldCursor);
+            ImGui::SetCursorScreenPos(oldCursor);
             ImGui::GetCurrentWindow()->DC.IsSetPos = oldIsSetPos;
 
             // is slot hovered?
@@ -1166,15 +2318,251 @@ void NodeArea::EndSlot(NodeState &node, int inputType, int outputType) {
     }
 
     draw_list->PopClipRect();
-    node.lastCursor = ImGui::GetCursorPos();
+    node.lastCursor = getNodeCursorPos(*this, node);
+}
+
+void NodeArea::Invalidate(NodeState &node) {
+    node.forceRedraw = true;
+    state.invalidated = true;
+    ImVec2 max = node.pos + ImMax(node.size, ImVec2());
+    ImVec4 rect(node.pos.x, node.pos.y, max.x, max.y);
+    if (node.id >= 0 && node.id < state.nodeIndex.itemCount()) {
+        state.nodeIndex.update(node.id, rect);
+    }
+    if (node.id >= 0) {
+        state.graphBounds.update(node.id, rect);
+    }
+    if (state.useGeometryTable) {
+        state.geometry.set(node);
+    }
+}
+
+void NodeArea::Invalidate(ImVec2 const &min, ImVec2 const &max) {
+    state.pendingDirtyRects.push_back(ImVec4(min.x, min.y, max.x, max.y));
+}
+
+void NodeArea::DrawMinimap(ImVec2 size) {
+    Minimap &minimap = state.minimap;
+    if (!minimap.enabled) {
+        minimap.enabled = true;
+        state.graphBounds.trackChanges = true;
+        state.graphBounds.changed.clear();
+        minimap.rebuild(state.graphBounds);
+    }
+
+    if (!state.idleFrame) {
+        ++minimap.frame;
+        minimap.sweepEdges(std::max(256, (int)minimap.edges.size() / 60));
+    }
+
+    // apply the nodes changed since the last call, rebuild if one left the mapped area or the
+    // graph shrank to a fraction of it
+    bool rebuild = false;
+    for (int id : state.graphBounds.changed) {
+        ImVec4 const &rect = state.graphBounds.rect(id);
+        if (rect.x <= rect.z && (rect.x < minimap.area.x || rect.y < minimap.area.y || rect.z > minimap.area.z || rect.w > minimap.area.w)) {
+            rebuild = true;
+            break;
+        }
+        minimap.setNode(id, rect);
+    }
+    state.graphBounds.changed.clear();
+    if (!state.graphBounds.empty()) {
+        ImVec4 graph = state.graphBounds.bounds();
+        rebuild = rebuild || (
+            (graph.z - graph.x) * 4.f < (minimap.area.z - minimap.area.x) &&
+            (graph.w - graph.y) * 4.f < (minimap.area.w - minimap.area.y));
+    }
+    if (rebuild) {
+        minimap.rebuild(state.graphBounds);
+    }
+
+    // fit the mapped area into size, keeping its aspect ratio
+    ImVec2 areaSize(minimap.area.z - minimap.area.x, minimap.area.w - minimap.area.y);
+    float scale = std::min(size.x / areaSize.x, size.y / areaSize.y);
+    ImVec2 mapSize = areaSize * scale;
+    const float margin = 8.f;
+    ImVec2 windowMax = ImGui::GetWindowPos() + ImGui::GetWindowSize();
+    ImVec2 mapMin = windowMax - mapSize - ImVec2(margin, margin);
+    ImVec2 mapOrigin = mapMin - ImVec2(minimap.area.x, minimap.area.y) * scale;
+
+    ImVec2 oldCursor = ImGui::GetCursorScreenPos();
+    ImGui::SetCursorScreenPos(mapMin);
+    ImGui::InvisibleButton("##minimap", mapSize);
+    minimap.capturesMouse = ImGui::IsItemHovered() || ImGui::IsItemActive();
+    if (ImGui::IsItemActive()) {
+        // center the view on the clicked point
+        ImVec2 target = (ImGui::GetMousePos() - mapOrigin) / scale;
+        SetView(state.zoom, -target + (state.lastOuterWindowSize / 2.f) / state.zoom);
+    }
+    ImGui::SetCursorScreenPos(oldCursor);
+
+    ImDrawList *drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(mapMin, mapMin + mapSize, IM_COL32(20, 20, 20, 200));
+    float cellScreenSize = minimap.cellSize * scale;
+    ImU32 edgeColor = ImColor(style[Style_EdgeColor].Value.x, style[Style_EdgeColor].Value.y, style[Style_EdgeColor].Value.z, 0.5f);
+    ImVec2 cellCenter(cellScreenSize * 0.5f, cellScreenSize * 0.5f);
+    ImVec2 gridMin = mapMin;
+    int cellCount = minimap.columns * minimap.rows;
+    for (auto const &link : minimap.links) {
+        int a = link.first / cellCount;
+        int b = link.first % cellCount;
+        ImVec2 pa = gridMin + ImVec2((float)(a % minimap.columns), (float)(a / minimap.columns)) * cellScreenSize + cellCenter;
+        ImVec2 pb = gridMin + ImVec2((float)(b % minimap.columns), (float)(b / minimap.columns)) * cellScreenSize + cellCenter;
+        drawList->AddLine(pa, pb, edgeColor);
+    }
+    ImColor nodeFill = style[Style_NodeBorder];
+    for (int i = 0; i < cellCount; ++i) {
+        if (minimap.cellNodes[i] > 0) {
+            ImVec2 cellMin = gridMin + ImVec2((float)(i % minimap.columns), (float)(i / minimap.columns)) * cellScreenSize;
+            nodeFill.Value.w = std::min(1.f, 0.4f + 0.15f * (float)minimap.cellNodes[i]);
+            drawList->AddRectFilled(cellMin, cellMin + ImVec2(cellScreenSize, cellScreenSize), nodeFill);
+        }
+    }
+    ImVec2 viewMin = mapOrigin + ConvertToNodeAreaPosition(ImVec2()) * scale;
+    ImVec2 viewMax = mapOrigin + ConvertToNodeAreaPosition(state.lastOuterWindowSize) * scale;
+    drawList->PushClipRect(mapMin, mapMin + mapSize, true);
+    drawList->AddRect(viewMin, viewMax, style[Style_NodeBorderSelected]);
+    drawList->PopClipRect();
+    drawList->AddRect(mapMin, mapMin + mapSize, style[Style_NodeBorder]);
+}
+
+void NodeArea::SetView(float zoom, ImVec2 innerWndPos) {
+    state.requestedZoom = zoom;
+    state.requestedWndPos = innerWndPos;
+    state.viewRequested = true;
+    state.invalidated = true;
+}
+
+void NodeArea::Invalidate() {
+    state.invalidated = true;
+}
+
+void NodeArea::ForgetNode(int id) {
+    if (id >= 0 && id < state.nodeIndex.itemCount()) {
+        state.nodeIndex.remove(id);
+    }
+    state.graphBounds.remove(id);
+    state.geometry.remove(id);
+    if (!state.singleWindow) {
+        state.forgottenNodes.push_back(id);
+    }
+    state.invalidated = true;
+}
+
+namespace {
+
+// Shared tail of the bulk transforms: the rows matching mask were changed from their old bounds.
+// Writes them back to the nodes and invalidates the union of the old and new bounds once.
+void applyGeometry(NodeArea &area, unsigned char mask, ImVec4 const &oldBounds, std::function<NodeState*(int)> const &node) {
+    NodeArea::InternalState &state = area.state;
+    NodeArea::GeometryTable &geometry = state.geometry;
+    ImVec4 newBounds;
+    if (!geometry.bounds(mask, newBounds)) {
+        return;
+    }
+    for (int id = 0; id < geometry.count(); ++id) {
+        if ((geometry.flags[id] & mask) != mask) {
+            continue;
+        }
+        indexGeometryRow(state, id);
+        if (NodeState *n = node ? node(id) : nullptr) {
+            n->pos = ImVec2(geometry.x[id], geometry.y[id]);
+            n->posFloat = ImVec2(geometry.floatX[id], geometry.floatY[id]);
+            n->forceRedraw = true;
+            geometry.flags[id] &= (unsigned char)~NodeArea::GeometryTable::Flag_Moved;
+        } else {
+            geometry.flags[id] |= NodeArea::GeometryTable::Flag_Moved;
+        }
+    }
+    area.Invalidate(
+        ImVec2(std::min(oldBounds.x, newBounds.x), std::min(oldBounds.y, newBounds.y)),
+        ImVec2(std::max(oldBounds.z, newBounds.z), std::max(oldBounds.w, newBounds.w)));
+    area.Invalidate();
+}
+
+const unsigned char selectedRows = NodeArea::GeometryTable::Flag_Alive | NodeArea::GeometryTable::Flag_Selected;
+
+} // unnamed namespace
+
+void NodeArea::TranslateSelection(ImVec2 delta, bool snap, std::function<NodeState*(int)> const &node) {
+    ImVec4 oldBounds;
+    state.geometry.select(state.selectedNodes);
+    if (!state.geometry.bounds(selectedRows, oldBounds)) {
+        return;
+    }
+    state.geometry.translate(selectedRows, delta, snap, state.snapGrid, style[Style_EdgeSize]);
+    applyGeometry(*this, selectedRows, oldBounds, node);
+}
+
+void NodeArea::SnapSelection(std::function<NodeState*(int)> const &node) {
+    ImVec4 oldBounds;
+    state.geometry.select(state.selectedNodes);
+    if (!state.geometry.bounds(selectedRows, oldBounds)) {
+        return;
+    }
+    state.geometry.snap(selectedRows, state.snapGrid, style[Style_EdgeSize]);
+    applyGeometry(*this, selectedRows, oldBounds, node);
+}
+
+void NodeArea::AlignSelection(Alignment alignment, std::function<NodeState*(int)> const &node) {
+    ImVec4 oldBounds;
+    state.geometry.select(state.selectedNodes);
+    if (!state.geometry.bounds(selectedRows, oldBounds)) {
+        return;
+    }
+    state.geometry.align(selectedRows, alignment, oldBounds);
+    applyGeometry(*this, selectedRows, oldBounds, node);
+}
+
+void NodeArea::DistributeSelection(bool horizontal, std::function<NodeState*(int)> const &node) {
+    ImVec4 oldBounds;
+    state.geometry.select(state.selectedNodes);
+    if (!state.geometry.bounds(selectedRows, oldBounds)) {
+        return;
+    }
+    state.geometry.distribute(selectedRows, horizontal);
+    applyGeometry(*this, selectedRows, oldBounds, node);
+}
+
+void NodeArea::QueryVisibleNodes(std::vector<int> &ids) const {
+    ImVec2 min = ConvertToNodeAreaPosition(ImVec2());
+    ImVec2 max = ConvertToNodeAreaPosition(state.lastOuterWindowSize);
+    size_t first = ids.size();
+    state.geometry.query(ImVec4(min.x, min.y, max.x, max.y), ids);
+    int selectionSize = std::min(state.geometry.count(), (int)state.selectedNodes.selectedItems.size());
+    for (int id = 0; id < selectionSize; ++id) {
+        if (state.selectedNodes.selectedItems[id] && state.geometry.contains(id)) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin() + first, ids.end());
+    ids.erase(std::unique(ids.begin() + first, ids.end()), ids.end());
+}
+
+bool NodeArea::GetGraphBounds(ImVec2 *min, ImVec2 *max) const {
+    if (state.graphBounds.empty()) {
+        return false;
+    }
+    ImVec4 bounds = state.graphBounds.bounds();
+    if (min) {
+        *min = ImVec2(bounds.x, bounds.y);
+    }
+    if (max) {
+        *max = ImVec2(bounds.z, bounds.w);
+    }
+    return true;
 }
 
 bool NodeArea::DrawEdge(int edgeId, NodeState const &sourceNode, int sourceSlot, NodeState const &sinkNode, int sinkSlot) {
+    if (state.minimap.enabled) {
+        state.minimap.noteEdge(edgeId, sourceNode.id, sinkNode.id);
+    }
     if (sourceNode.outputSlots.size() <= sourceSlot || sinkNode.inputSlots.size() <= sinkSlot)
-        return false;
+        // slots of pending nodes are not known yet, which does not make the edge invalid
+        return isNodePending(sourceNode) || isNodePending(sinkNode);
 
     ImVec2 offset = ImGui::GetWindowPos();
-    ImDrawList* draw_list = ImGui::GetWindowDrawList();
     ImVec2 p1 = sourceNode.outputSlots[sourceSlot].pos;
     ImVec2 cp1 = p1 + ImVec2(+50, 0);
     ImVec2 p2 = sinkNode.inputSlots[sinkSlot].pos;
@@ -1188,16 +2576,18 @@ bool NodeArea::DrawEdge(int edgeId, NodeState const &sourceNode, int sourceSlot,
 
     p1 += offset; p2 += offset; cp1 += offset; cp2 += offset;
 
-    bool hovered = state.outerWindowFocused && ImGui::IsWindowHovered() &&
+    bool hovered = state.outerWindowFocused && isNodeAreaHovered(*this) &&
         closeToBezier(ImGui::GetMousePos(), p1, cp1, cp2, p2, 8.f);
     if (state.selectedEdges.isSelected(edgeId) || wouldSelect) {
-        draw_list->AddBezierCubic(p1, cp1, cp2, p2, style[Style_EdgeSelectedColor], style[Style_EdgeSelectedSize]);
+        addEdgeStroke(*this, EdgeLayer_SelectedUnderlay, p1, cp1, cp2, p2, style[Style_EdgeSelectedColor], style[Style_EdgeSelectedSize]);
     }
 
     ImColor color = style[Style_EdgeColor];
+    EdgeLayer layer = EdgeLayer_Normal;
     if (hovered && state.mode == Mode::None) {
         state.hoveredEdge = edgeId;
         color = style[Style_EdgeHovered];
+        layer = EdgeLayer_Hovered;
         if (ImGui::IsMouseClicked(0)) {
             if (!ImGui::GetIO().KeyShift) {
                 clearAllSelections();
@@ -1206,11 +2596,103 @@ bool NodeArea::DrawEdge(int edgeId, NodeState const &sourceNode, int sourceSlot,
         }
     }
 
-    draw_list->AddBezierCubic(p1, cp1, cp2, p2, color, style[Style_EdgeSize]);
+    addEdgeStroke(*this, layer, p1, cp1, cp2, p2, color, style[Style_EdgeSize]);
 
     return true;
 }
 
+int NodeArea::DrawEdges(EdgeDesc const *edges, int count, bool *drawn) {
+    if (state.minimap.enabled) {
+        for (int i = 0; i < count; ++i) {
+            state.minimap.noteEdge(edges[i].edgeId, edges[i].sourceNode->id, edges[i].sinkNode->id);
+        }
+    }
+    ImVec2 offset = ImGui::GetWindowPos();
+    ImVec2 mousePos = ImGui::GetMousePos();
+    const bool hoverable = state.outerWindowFocused && isNodeAreaHovered(*this);
+    const bool selecting = state.mode != Mode::None;
+    const bool enclosedOnly = ImGui::GetIO().KeyAlt;
+    const float hoverDistance = 8.f;
+
+    ImRect selectionRect = defaultBoundsRect;
+    selectionRect.Add(state.dragStart);
+    selectionRect.Add(state.dragEnd);
+
+    state.edgeInstances.resize(count);
+    EdgeInstance *instances = state.edgeInstances.data();
+
+    // Pure per edge math first, this does not touch any ImGui or node area state.
+    runParallel(state.threadPool.get(), count, 1024, [&](int begin, int end, int) {
+        for (int i = begin; i < end; ++i) {
+            EdgeDesc const &edge = edges[i];
+            EdgeInstance &instance = instances[i];
+            instance.valid =
+                edge.sourceSlot >= 0 && edge.sourceSlot < (int)edge.sourceNode->outputSlots.size() &&
+                edge.sinkSlot >= 0 && edge.sinkSlot < (int)edge.sinkNode->inputSlots.size();
+            instance.pending = !instance.valid && (isNodePending(*edge.sourceNode) || isNodePending(*edge.sinkNode));
+            if (!instance.valid) {
+                continue;
+            }
+            ImVec2 p1 = edge.sourceNode->outputSlots[edge.sourceSlot].pos;
+            ImVec2 cp1 = p1 + ImVec2(+50, 0);
+            ImVec2 p2 = edge.sinkNode->inputSlots[edge.sinkSlot].pos;
+            ImVec2 cp2 = p2 + ImVec2(-50, 0);
+
+            instance.inSelectionRect = selecting && edgeTouchesRect(selectionRect, enclosedOnly, p1, cp1, cp2, p2);
+
+            instance.p1 = p1 + offset; instance.cp1 = cp1 + offset;
+            instance.cp2 = cp2 + offset; instance.p2 = p2 + offset;
+
+            ImRect aabb = defaultBoundsRect;
+            aabb.Add(instance.p1); aabb.Add(instance.cp1); aabb.Add(instance.cp2); aabb.Add(instance.p2);
+            aabb.Expand(hoverDistance);
+            instance.hoverCandidate = hoverable && aabb.Contains(mousePos);
+        }
+    });
+
+    // Selection and hover handling in submission order, same behavior as DrawEdge.
+    int drawnCount = 0;
+    for (int i = 0; i < count; ++i) {
+        EdgeInstance const &instance = instances[i];
+        if (drawn) {
+            drawn[i] = instance.valid || instance.pending;
+        }
+        if (!instance.valid) {
+            continue;
+        }
+        ++drawnCount;
+
+        int edgeId = edges[i].edgeId;
+        if (state.mode == Mode::SelectAll) {
+            state.selectedEdges.addToSelection(edgeId);
+        }
+        bool wouldSelect = instance.inSelectionRect && applyEdgeDragSelection(*this, edgeId);
+        bool hovered = instance.hoverCandidate &&
+            closeToBezier(mousePos, instance.p1, instance.cp1, instance.cp2, instance.p2, hoverDistance);
+
+        if (state.selectedEdges.isSelected(edgeId) || wouldSelect) {
+            addEdgeStroke(*this, EdgeLayer_SelectedUnderlay, instance.p1, instance.cp1, instance.cp2, instance.p2, style[Style_EdgeSelectedColor], style[Style_EdgeSelectedSize]);
+        }
+
+        ImColor color = style[Style_EdgeColor];
+        EdgeLayer layer = EdgeLayer_Normal;
+        if (hovered && state.mode == Mode::None) {
+            state.hoveredEdge = edgeId;
+            color = style[Style_EdgeHovered];
+            layer = EdgeLayer_Hovered;
+            if (ImGui::IsMouseClicked(0)) {
+                if (!ImGui::GetIO().KeyShift) {
+                    clearAllSelections();
+                }
+                state.selectedEdges.toggleSelection(edgeId);
+            }
+        }
+        addEdgeStroke(*this, layer, instance.p1, instance.cp1, instance.cp2, instance.p2, color, style[Style_EdgeSize]);
+    }
+
+    return drawnCount;
+}
+
 bool NodeArea::GetNewEdge(int *edgeSourceNode, int *edgeSourceNodeSlot, int *edgeSinkNode, int *edgeSinkNodeSlot) const
 {
     if (ImGui::IsMouseReleased(0) && state.edgeStartNode != state.edgeEndNode &&
@@ -10,6 +10,8 @@
 #include <vector>
 #include <array>
 #include <functional>
+#include <memory>
+#include <unordered_map>
 #include <cstdint>
 
 namespace nodes {
@@ -22,8 +24,8 @@ typedef int NodeAreaFlags; // These flags should typically only be set for one f
 enum NodeAreaFlags_ {
     NodeAreaFlags_UpdateStyle = 1 << 0, // Applies the current ImGui style to the node graph area.
     NodeAreaFlags_SnapToGrid  = 1 << 1, // Aligns all nodes to the configured snapGrid.
-    NodeAreaFlags_ForceRedraw = 1 << 2, // Redraws all visible and invisible nodes. Use
-                                        // after changing node positions/sizes programmatically.
+    NodeAreaFlags_ForceRedraw = 1 << 2, // Redraws all visible and invisible nodes. Prefer
+                                        // NodeArea::Invalidate after changing only a few nodes.
     NodeAreaFlags_ZoomToFit   = 1 << 3, // Changes zoom level to fit the whole graph on the visible screen.
     NodeAreaFlags_NoCopy      = 1 << 4  // Do not copy draw commands (does not display). Useful for
                                         // re-rendering the node ui until automatic resizes converge.
@@ -182,6 +184,32 @@ struct Style {
     void generate();
 };
 
+struct NodeArea;
+class ThreadPool;
+class NodeAllocator;
+class MutationQueue;
+class InputRecorder;
+struct Mutation;
+
+// One edge of a batched edge submission, see NodeArea::DrawEdges.
+struct EdgeDesc {
+    int edgeId;
+    NodeState const *sourceNode;
+    int sourceSlot;
+    NodeState const *sinkNode;
+    int sinkSlot;
+};
+
+// Pull based node submission for very large graphs. Instead of submitting every node each frame,
+// the application describes its nodes through these callbacks and NodeArea::SubmitNodes only
+// draws the nodes overlapping the visible area, plus the selected ones. Indices passed to the
+// callbacks are expected to match NodeState::id.
+struct NodeProvider {
+    std::function<int()> count;
+    std::function<ImVec4(int)> rect;            // node area rect of a node (min xy, max zw)
+    std::function<void(NodeArea&, int)> draw;   // submits a node via BeginNode/EndNode
+};
+
 struct NodeArea {
     enum class Mode {
         None,
@@ -191,6 +219,11 @@ struct NodeArea {
         Escaped, SelectAll
     };
 
+    enum class Alignment {
+        Left, CenterX, Right,
+        Top, CenterY, Bottom
+    };
+
     struct Selection {
         int selectedCount = 0;
         std::vector<bool> selectedItems; // there should be a specialization for this type ...
@@ -202,6 +235,143 @@ struct NodeArea {
         bool isSelected(int id) const;
     };
 
+    // Uniform grid over the node area, used by SubmitNodes to find visible nodes. Items are
+    // binned by the min corner of their rect, queries are expanded by the largest item size.
+    struct SpatialIndex {
+        float cellSize = 256.f;
+        int columns = 0;
+        int rows = 0;
+        ImVec2 maxItemSize;
+        std::vector<std::vector<int>> cells;
+        std::vector<ImVec4> itemRects;
+        std::vector<int> itemCell;  // cell of each item, -1 if not indexed
+        std::vector<int> itemSlot;  // position of each item in its cell
+
+        void reset(ImVec2 areaSize, int itemCount);
+        void grow(int itemCount);
+        void update(int item, ImVec4 const &rect);
+        void remove(int item);
+        void query(ImVec4 const &rect, std::vector<int> &result) const;
+        int itemCount() const { return (int)itemCell.size(); }
+    };
+
+    // Min/max tree over the rects of all nodes by id (min xy / max zw), leaves in the second half
+    // of the array. Updating a node is O(log n), the bounds of the whole graph are at the root.
+    struct BoundsTree {
+        int leafCount = 0;  // power of two
+        std::vector<ImVec4> rects;
+        bool trackChanges = false;
+        std::vector<int> changed;   // ids of changed leaves while trackChanges is set
+
+        void update(int id, ImVec4 const &rect);
+        void remove(int id);
+        bool empty() const;
+        ImVec4 bounds() const { return rects.empty() ? ImVec4() : rects[1]; }
+        ImVec4 const &rect(int id) const { return rects[leafCount + id]; }
+    };
+
+    // Overview of the graph drawn by DrawMinimap. Nodes are rasterized into a coarse grid of
+    // cells over the graph bounds (node counts per cell), edges into links between the cells of
+    // their end nodes. Both are updated from the changed leaves of the BoundsTree and the edges
+    // drawn each frame, so the work per frame depends on the number of changes and cells, not on
+    // the size of the graph.
+    struct Minimap {
+        struct CellRange {
+            int minX, minY, maxX, maxY;     // inclusive, minX > maxX if the node is not mapped
+        };
+        struct Edge {
+            int source, sink;
+            int lastFrame;
+        };
+
+        int resolution = 96;    // cells along the longer side of the mapped area
+        bool enabled = false;
+        int frame = 0;
+        ImVec4 area;            // mapped node area rect (min xy, max zw)
+        int columns = 0;
+        int rows = 0;
+        float cellSize = 1.f;
+        std::vector<int> cellNodes;
+        std::vector<CellRange> nodeCells;
+        std::vector<int> nodeCenter;            // cell of the node center, -1 if not mapped
+        std::vector<Edge> edges;                // by edge id, source -1 if unused
+        std::vector<std::vector<int>> nodeEdges;
+        std::unordered_map<int, int> links;     // edge count by cell pair
+        int edgeSweep = 0;
+        bool capturesMouse = false;
+
+        void rebuild(BoundsTree const &bounds);
+        void setNode(int id, ImVec4 const &rect);
+        void noteEdge(int id, int source, int sink);
+        void sweepEdges(int budget);
+        void link(int edge, int delta);
+        CellRange cellsOf(ImVec4 const &rect) const;
+    };
+
+    // Node geometry by id as separate arrays (struct of arrays), so that operations on many nodes
+    // run as tight, vectorizable loops instead of striding through the NodeStates. Rows mirror
+    // the NodeStates as they are submitted; moves applied to the table are picked up by EndNode.
+    struct GeometryTable {
+        enum Flags : unsigned char {
+            Flag_Alive = 1 << 0,
+            Flag_Selected = 1 << 1,
+            Flag_Moved = 1 << 2     // moved by the table, EndNode copies the position into the node
+        };
+
+        std::vector<float> x, y;            // NodeState::pos
+        std::vector<float> floatX, floatY;  // NodeState::posFloat
+        std::vector<float> w, h;            // NodeState::size, zero if not measured yet
+        std::vector<unsigned char> flags;
+
+        int count() const { return (int)flags.size(); }
+        bool contains(int id) const { return id >= 0 && id < count() && (flags[id] & Flag_Alive); }
+        void set(NodeState const &node);
+        void remove(int id);
+        void select(Selection const &selection);
+
+        // Operate on all rows with (flags & mask) == mask.
+        void translate(unsigned char mask, ImVec2 delta, bool snap, float grid, float offset);
+        void snap(unsigned char mask, float grid, float offset);
+        void align(unsigned char mask, Alignment alignment, ImVec4 const &to);
+        void distribute(unsigned char mask, bool horizontal);
+        bool bounds(unsigned char mask, ImVec4 &result) const;
+        void query(ImVec4 const &rect, std::vector<int> &result) const;
+    };
+
+    // Edges are collected per layer during the frame and emitted bottom to top by EndNodeArea.
+    enum EdgeLayer {
+        EdgeLayer_SelectedUnderlay = 0,
+        EdgeLayer_Normal,
+        EdgeLayer_Hovered,
+        EdgeLayer_Dragging,
+        EdgeLayer_Count_
+    };
+
+    // Screen space bezier curve to be tessellated and stroked into the window draw list.
+    struct EdgeStroke {
+        ImVec2 p1, cp1, cp2, p2;
+        ImU32 color;
+        float thickness;
+    };
+
+    // Vertex/index data of a range of edge strokes. Indices are relative to their stroke.
+    struct EdgeGeometry {
+        struct Run { int vtxBegin, vtxCount, idxBegin, idxCount; };
+        std::vector<ImVec2> points;
+        std::vector<ImDrawVert> vertices;
+        std::vector<ImDrawIdx> indices;
+        std::vector<Run> runs;
+    };
+
+    // Per edge data of a batched edge submission.
+    struct EdgeInstance {
+        ImVec2 p1, cp1, cp2, p2;
+        bool valid;
+        bool pending;   // not valid only because an end node was not measured yet
+        bool inSelectionRect;
+        bool hoverCandidate;
+    };
+
     struct InternalState {
         bool initialized = false;
         ImVec2 nodeAreaSize = ImVec2(20000.f, 20000.f);
@@ -220,8 +390,10 @@ struct NodeArea {
         ImVec2 dragStart;
         ImVec2 dragEnd;
 
-        ImVec2 lowerBound;
-        ImVec2 upperBound;
+        // Dirty rects (node area coordinates, min xy / max zw) collected by Invalidate. Rects
+        // pushed during a frame are applied to the node submissions of the following frame.
+        std::vector<ImVec4> pendingDirtyRects;
+        std::vector<ImVec4> dirtyRects;
 
         int edgeStartNode;
         int edgeStartSlot;
@@ -231,15 +403,102 @@ struct NodeArea {
         int activeNode = -1;
         int hoveredNode = -1;
         int hoveredEdge = -1;
+        int resizeNode = -1;        // last node resized by the user and its size when the resize started
+        ImVec2 resizeStartSize;
         Selection selectedNodes;
         Selection selectedEdges;
 
+        SpatialIndex nodeIndex;
+        std::vector<int> submitList;
+        BoundsTree graphBounds;
+
+        // Optional struct of arrays geometry (see GeometryTable). Node drags and SnapToGrid are
+        // then applied to all nodes in one pass per frame. Nodes moved by the application have to
+        // be passed to Invalidate(node) to update their row.
+        bool useGeometryTable = false;
+        GeometryTable geometry;
+        Minimap minimap;
+
+        // Amortized measurement (opt-in, measureBudgetMs > 0). Nodes which have to be redrawn but
+        // lie outside the visible area are not measured right away but over the following frames,
+        // closest to the view first, spending about measureBudgetMs per frame on them. Visible
+        // nodes are always measured immediately.
+        float measureBudgetMs = 0.f;
+        float measureCostMs = 0.05f;    // running average of one offscreen measurement
+        float measureSpentMs = 0.f;     // this frame
+        double measureStart = -1.0;     // of the offscreen node being measured, < 0 if none
+        int measureFrame = 0;
+        std::vector<int> measureGrant;  // per node id, the frame in which it may be measured
+        std::vector<std::pair<float, int>> measureCandidates; // deferred nodes (distance, id)
+
+        // Optional zoom band fonts: the same font rasterized at increasing sizes, the first one
+        // at the size used for layout. The inner context renders with the smallest band which is
+        // at least as large as the zoomed font size, scaled back to the layout size.
+        std::vector<ImFont*> zoomFonts;
+
+        // Optional, spreads the edge geometry generation of DrawEdges across threads.
+        std::shared_ptr<ThreadPool> threadPool;
+        // Optional, serves the allocations of the inner context from pools while the node area is
+        // current (between BeginNodeArea and EndNodeArea). Its frame arena is reset every frame.
+        // Set it before the first frame. ImGui heap objects (ImVector, ImDrawListSplitter, ...)
+        // created inside node content must also be freed inside a frame.
+        std::shared_ptr<NodeAllocator> allocator;
+        // Optional, graph changes posted from other threads. Drained at the start of BeginNodeArea,
+        // see MutationQueue for what is applied by the node area and what by mutationHandler.
+        std::shared_ptr<MutationQueue> mutationQueue;
+        int mutationBudget = 4096;  // per frame, the rest waits for the next frame
+        std::function<NodeState*(int)> mutationNode;
+        std::function<void(Mutation const&)> mutationHandler;
+        // Optional, records the input of every frame for replay (see InputRecorder).
+        std::shared_ptr<InputRecorder> recorder;
+        // View requested by SetView, applied by the next BeginNodeArea.
+        bool viewRequested = false;
+        float requestedZoom = 1.f;
+        ImVec2 requestedWndPos;
+        std::vector<EdgeInstance> edgeInstances;
+        std::array<std::vector<EdgeStroke>, EdgeLayer_Count_> edgeLayers;
+        std::vector<EdgeStroke> edgeStrokes;
+        std::vector<EdgeGeometry> edgeGeometry;
+        std::vector<int> copyPrefix;  // per draw list offsets of the parallel draw data copy
+
         NodeAreaFlags flags;
 
         bool outerWindowFocused;
         bool outerWindowHovered;
         bool anyItemActive;
         bool anySizeChanged;
+
+        // Idle frame detection (opt-in). When there was no input, no invalidation and nothing
+        // moved for a few frames, BeginNodeArea returns false and EndNodeArea re-emits the draw
+        // data of the last rendered frame. Requires calling Invalidate() on content changes.
+        bool skipIdleFrames = false;
+        bool idleFrame = false;
+        bool invalidated = false;
+        int quietFrames = 0;
+        ImVec2 lastOuterWindowPos;
+        ImVec2 lastOuterWindowSize;
+        ImDrawData *lastDrawData = nullptr;
+
+        // Single window backend (opt-in, set before the first frame). Nodes are drawn into the
+        // node area window instead of one inner window each, on a draw list channel above the
+        // edges. Only the topmost node under the mouse (the last one submitted over it) and the
+        // node owning the active item receive mouse input, the items of other nodes are disabled.
+        bool singleWindow = false;
+        std::shared_ptr<ImDrawListSplitter> nodeChannels;
+        int mouseNode = -1;
+        int nextMouseNode = -1;
+        int activeItemNode = -1;
+        int nextActiveItemNode = -1;
+        ImGuiID nodeActiveIdAlive = 0;  // ActiveIdIsAlive when the current node began
+
+        // Inner window garbage collection. Culled nodes do not begin their window. Windows of
+        // nodes which were not drawn for compactWindowFrames frames release their draw buffers,
+        // after destroyWindowFrames frames they are destroyed (0 disables either). The windows of
+        // nodes passed to ForgetNode are destroyed at the start of the next frame.
+        int compactWindowFrames = 300;
+        int destroyWindowFrames = 3600;
+        std::vector<int> forgottenNodes;
+        int windowGcCursor = 0;
     } state;
 
     Style style;
@@ -249,16 +508,70 @@ struct NodeArea {
         state.selectedEdges.clearSelection();
     }
 
-    void BeginNodeArea(std::function<void(UserAction)> actionCallback, NodeAreaFlags flags);
+    // Returns false on idle frames (see InternalState::skipIdleFrames). Do not submit nodes and
+    // edges in that case, but still call EndNodeArea.
+    bool BeginNodeArea(std::function<void(UserAction)> actionCallback, NodeAreaFlags flags);
     void EndNodeArea();
 
     bool BeginNode(NodeState &node, bool resizeable = false);
     void EndNode(NodeState &node);
 
+    // Draws the visible, selected and edge dragging nodes of a provider. Call instead of
+    // submitting all nodes, between BeginNodeArea and EndNodeArea.
+    void SubmitNodes(NodeProvider const &provider);
+
     void BeginSlot(NodeState &node);
     void EndSlot(NodeState &node, int inputType = -1, int outputType = -1);
 
+    // Marks a single node for redraw/remeasure on its next submission. Use after changing
+    // the position/size of a node programmatically instead of NodeAreaFlags_ForceRedraw.
+    void Invalidate(NodeState &node);
+    // Redraws all nodes overlapping the given rect (node area coordinates) next frame.
+    void Invalidate(ImVec2 const &min, ImVec2 const &max);
+    // Notes that the graph or node contents changed, which ends idle frame skipping.
+    void Invalidate();
+
+    // Draws an overview of the whole graph (see Minimap) into the bottom right corner of the node
+    // area window. Call after EndNodeArea, also on idle frames. Clicking or dragging on it
+    // centers the view on that point.
+    void DrawMinimap(ImVec2 size = ImVec2(200.f, 150.f));
+
+    // Sets the zoom level and the position of the node area origin relative to the window
+    // (InternalState::innerWndPos) on the next BeginNodeArea.
+    void SetView(float zoom, ImVec2 innerWndPos);
+
+    // Call when a node is deleted or hidden: it no longer counts towards the graph bounds, is
+    // dropped from the index of SubmitNodes and its inner window is destroyed.
+    void ForgetNode(int id);
+    // Bounds of all nodes submitted so far (node area coordinates), kept up to date as nodes are
+    // moved, resized or invalidated. Returns false if there are no nodes.
+    bool GetGraphBounds(ImVec2 *min, ImVec2 *max) const;
+    // Bulk transforms of the selected nodes, computed on the geometry table (requires
+    // state.useGeometryTable) in one pass. The new positions are written to the NodeStates returned
+    // by node (which may return null for nodes the application does not hold), the nodes are
+    // redrawn and their old and new area is invalidated at once. Usable outside of a frame.
+    void TranslateSelection(ImVec2 delta, bool snap, std::function<NodeState*(int)> const &node);
+    void SnapSelection(std::function<NodeState*(int)> const &node);
+    // Aligns the selection to the given edge or center of its bounds.
+    void AlignSelection(Alignment alignment, std::function<NodeState*(int)> const &node);
+    // Spaces the selected nodes evenly between the outermost ones, keeping their order.
+    void DistributeSelection(bool horizontal, std::function<NodeState*(int)> const &node);
+    // Appends the ids of the nodes overlapping the visible area and of all selected nodes, from
+    // the geometry table (useGeometryTable), in ascending order. For applications submitting
+    // nodes without a NodeProvider. Selected nodes are included like in SubmitNodes: a drag moves
+    // them in the table and they have to be submitted to get the move into their NodeState.
+    void QueryVisibleNodes(std::vector<int> &ids) const;
+
     bool DrawEdge(int edgeId, NodeState const &sourceNode, int sourceSlot, NodeState const &sinkNode, int sinkSlot);
+    // Edges are not drawn immediately but batched per EdgeLayer. EndNodeArea tessellates and
+    // strokes all of them at once (on state.threadPool if set) into one contiguous vertex run
+    // below the nodes.
+    // DrawEdge returns false for invalid edges (slot indices out of range). Edges of nodes which
+    // are not measured yet (new nodes, offscreen nodes deferred by measureBudgetMs) are pending:
+    // DrawEdge returns true but nothing is drawn until both ends are measured.
+    // DrawEdges submits many edges at once. drawn (optional, count entries) receives what
+    // DrawEdge would have returned for each edge. Returns the number of actually drawn edges.
+    int DrawEdges(EdgeDesc const *edges, int count, bool *drawn = nullptr);
     bool GetNewEdge(int *edgeSourceNode, int *edgeSourceNodeSlot, int *edgeSinkNode, int *edgeSinkNodeSlot) const;
 
     ImVec2 GetAbsoluteMousePos() const;
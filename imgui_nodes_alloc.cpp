@@ -0,0 +1,199 @@
+#include "imgui_nodes_alloc.hpp"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+
+namespace nodes {
+
+namespace {
+
+const size_t minPooledSize = 16;
+const int sizeClassCount = 8;   // 16 .. maxPooledSize
+
+int sizeClassOf(size_t size) {
+    int sizeClass = 0;
+    for (size_t classSize = minPooledSize; classSize < size; classSize *= 2) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+size_t classSizeOf(int sizeClass) {
+    return minPooledSize << sizeClass;
+}
+
+} // unnamed namespace
+
+NodeAllocator::NodeAllocator(size_t chunkSize, size_t frameBlockSize)
+    : chunkSize(std::max(chunkSize, maxPooledSize))
+    , frameBlockSize(frameBlockSize)
+    , freeLists(sizeClassCount, nullptr)
+{
+    static_assert((minPooledSize << (sizeClassCount - 1)) == maxPooledSize, "size classes do not match maxPooledSize");
+}
+
+NodeAllocator::~NodeAllocator() {
+    if (isInstalled) {
+        uninstall();
+    }
+    for (Chunk &chunk : chunks) {
+        std::free(chunk.begin);
+    }
+    for (FrameBlock &block : frameBlocks) {
+        std::free(block.begin);
+    }
+}
+
+int NodeAllocator::findChunk(void const *ptr) const {
+    char const *p = static_cast<char const*>(ptr);
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), p, [](char const *value, Chunk const &chunk) {
+        return std::less<char const*>()(value, chunk.begin);
+    });
+    if (it == chunks.begin()) {
+        return -1;
+    }
+    --it;
+    return std::less<char const*>()(p, it->begin + chunkSize) ? (int)(it - chunks.begin()) : -1;
+}
+
+bool NodeAllocator::owns(void const *ptr) const {
+    return ptr && findChunk(ptr) != -1;
+}
+
+void *NodeAllocator::forwardAlloc(size_t size) {
+    ++statistics.forwardedAllocations;
+    return previousAlloc ? previousAlloc(size, previousUserData) : std::malloc(size);
+}
+
+void NodeAllocator::forwardFree(void *ptr) {
+    if (previousFree) {
+        previousFree(ptr, previousUserData);
+    } else {
+        std::free(ptr);
+    }
+}
+
+void *NodeAllocator::allocate(size_t size) {
+    ++statistics.allocations;
+    if (size == 0 || size > maxPooledSize) {
+        return forwardAlloc(size);
+    }
+
+    int sizeClass = sizeClassOf(size);
+    size_t classSize = classSizeOf(sizeClass);
+    if (!freeLists[sizeClass]) {
+        char *begin = static_cast<char*>(std::malloc(chunkSize));
+        if (!begin) {
+            return nullptr;
+        }
+        Chunk chunk = { begin, sizeClass };
+        chunks.insert(std::upper_bound(chunks.begin(), chunks.end(), begin, [](char const *value, Chunk const &other) {
+            return std::less<char const*>()(value, other.begin);
+        }), chunk);
+        statistics.poolReservedBytes += chunkSize;
+
+        // thread the blocks of the new chunk onto the free list, first block on top
+        size_t blockCount = chunkSize / classSize;
+        for (size_t i = blockCount; i-- > 0;) {
+            void *block = begin + i * classSize;
+            *static_cast<void**>(block) = freeLists[sizeClass];
+            freeLists[sizeClass] = block;
+        }
+    }
+
+    void *block = freeLists[sizeClass];
+    freeLists[sizeClass] = *static_cast<void**>(block);
+    statistics.poolBytes += classSize;
+    statistics.poolPeakBytes = std::max(statistics.poolPeakBytes, statistics.poolBytes);
+    return block;
+}
+
+void NodeAllocator::deallocate(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    int chunk = findChunk(ptr);
+    if (chunk == -1) {
+        forwardFree(ptr);
+        return;
+    }
+    int sizeClass = chunks[chunk].sizeClass;
+    *static_cast<void**>(ptr) = freeLists[sizeClass];
+    freeLists[sizeClass] = ptr;
+    statistics.poolBytes -= classSizeOf(sizeClass);
+}
+
+void *NodeAllocator::allocateFrame(size_t size, size_t alignment) {
+    if (!frameBlocks.empty()) {
+        FrameBlock &block = frameBlocks.back();
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.begin);
+        size_t offset = (size_t)(((base + frameUsed + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+        if (offset + size <= block.size) {
+            statistics.frameBytes += offset + size - frameUsed;
+            statistics.framePeakBytes = std::max(statistics.framePeakBytes, statistics.frameBytes);
+            frameUsed = offset + size;
+            return block.begin + offset;
+        }
+    }
+
+    FrameBlock block;
+    block.size = std::max(frameBlockSize, size + alignment);
+    block.begin = static_cast<char*>(std::malloc(block.size));
+    if (!block.begin) {
+        return nullptr;
+    }
+    frameBlocks.push_back(block);
+    statistics.frameReservedBytes += block.size;
+    frameUsed = 0;
+    return allocateFrame(size, alignment);
+}
+
+void NodeAllocator::resetFrame() {
+    // a frame which spilled into several blocks gets one block covering all of them, so the
+    // steady state is a single block
+    if (frameBlocks.size() > 1) {
+        size_t total = 0;
+        for (FrameBlock &block : frameBlocks) {
+            total += block.size;
+            std::free(block.begin);
+        }
+        frameBlocks.clear();
+        FrameBlock block;
+        block.size = total;
+        block.begin = static_cast<char*>(std::malloc(total));
+        statistics.frameReservedBytes = 0;
+        if (block.begin) {
+            frameBlocks.push_back(block);
+            statistics.frameReservedBytes = total;
+        }
+    }
+    frameUsed = 0;
+    statistics.frameBytes = 0;
+}
+
+void *NodeAllocator::allocFunc(size_t size, void *userData) {
+    return static_cast<NodeAllocator*>(userData)->allocate(size);
+}
+
+void NodeAllocator::freeFunc(void *ptr, void *userData) {
+    static_cast<NodeAllocator*>(userData)->deallocate(ptr);
+}
+
+void NodeAllocator::install() {
+    IM_ASSERT(!isInstalled);
+    ImGui::GetAllocatorFunctions(&previousAlloc, &previousFree, &previousUserData);
+    ImGui::SetAllocatorFunctions(&NodeAllocator::allocFunc, &NodeAllocator::freeFunc, this);
+    isInstalled = true;
+}
+
+void NodeAllocator::uninstall() {
+    IM_ASSERT(isInstalled);
+    ImGui::SetAllocatorFunctions(previousAlloc, previousFree, previousUserData);
+    isInstalled = false;
+}
+
+} // namespace nodes
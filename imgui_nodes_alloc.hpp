@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace nodes {
+
+// Allocator for the inner ImGui context of a NodeArea (set NodeArea::state.allocator). While the
+// node area is current it is installed with ImGui::SetAllocatorFunctions, small blocks (windows,
+// ID stacks, storage, vectors of the nodes) then come from size class pools carved out of large
+// chunks, larger ones (draw list buffers) are forwarded to the previously installed functions.
+// Blocks allocated elsewhere are recognized by address and freed by the previous functions. The
+// opposite does not work: pooled blocks must be freed while the allocator is installed, never by
+// the previous functions after uninstall().
+// Additionally owns a bump arena for per frame scratch memory of the application (e.g. in node
+// content), reset by BeginNodeArea. The node area itself reuses persistent buffers instead.
+// Not thread safe, like ImGui itself.
+class NodeAllocator {
+public:
+    struct Stats {
+        size_t poolBytes = 0;           // bytes in pooled blocks currently handed out
+        size_t poolPeakBytes = 0;
+        size_t poolReservedBytes = 0;   // bytes of all pool chunks
+        size_t forwardedAllocations = 0; // allocate calls passed on to the previous functions
+        size_t frameBytes = 0;          // arena bytes used since the last resetFrame
+        size_t framePeakBytes = 0;
+        size_t frameReservedBytes = 0;
+        size_t allocations = 0;         // total number of allocate calls
+    };
+
+    static const size_t maxPooledSize = 2048;
+
+    explicit NodeAllocator(size_t chunkSize = 64 * 1024, size_t frameBlockSize = 64 * 1024);
+    ~NodeAllocator();
+
+    NodeAllocator(NodeAllocator const&) = delete;
+    NodeAllocator& operator=(NodeAllocator const&) = delete;
+
+    void *allocate(size_t size);
+    void deallocate(void *ptr);
+    bool owns(void const *ptr) const;
+
+    // Scratch memory valid until the next resetFrame. Blocks are never freed individually.
+    void *allocateFrame(size_t size, size_t alignment = alignof(std::max_align_t));
+    void resetFrame();
+
+    // Makes this the ImGui allocator until uninstall(), remembering the current functions.
+    void install();
+    void uninstall();
+    bool installed() const { return isInstalled; }
+
+    Stats const &stats() const { return statistics; }
+
+private:
+    struct Chunk {
+        char *begin;
+        int sizeClass;
+    };
+    struct FrameBlock {
+        char *begin;
+        size_t size;
+    };
+
+    static void *allocFunc(size_t size, void *userData);
+    static void freeFunc(void *ptr, void *userData);
+
+    int findChunk(void const *ptr) const;
+    void *forwardAlloc(size_t size);
+    void forwardFree(void *ptr);
+
+    size_t chunkSize;
+    size_t frameBlockSize;
+    std::vector<Chunk> chunks;              // sorted by address
+    std::vector<void*> freeLists;           // per size class, intrusive singly linked
+    std::vector<FrameBlock> frameBlocks;
+    size_t frameUsed = 0;                   // in the last frame block
+
+    bool isInstalled = false;
+    void *(*previousAlloc)(size_t, void*) = nullptr;
+    void (*previousFree)(void*, void*) = nullptr;
+    void *previousUserData = nullptr;
+
+    Stats statistics;
+};
+
+} // namespace nodes
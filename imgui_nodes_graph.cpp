@@ -0,0 +1,420 @@
+#include "imgui_nodes_graph.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace nodes {
+
+// Takes the given free slot (or the first free one for index == -1) off the free list, growing
+// the slot vector as needed.
+template<typename Slot>
+int GraphStore::allocSlot(std::vector<Slot> &slots, int &freeHead, int index) {
+    if (index == -1) {
+        index = freeHead != -1 ? freeHead : (int)slots.size();
+    }
+    while ((int)slots.size() <= index) {
+        slots.emplace_back();
+        releaseSlot(slots, freeHead, (int)slots.size() - 1);
+    }
+    Slot &slot = slots[index];
+    IM_ASSERT(!slot.alive);
+    if (slot.prevFree != -1) {
+        slots[slot.prevFree].nextFree = slot.nextFree;
+    } else {
+        freeHead = slot.nextFree;
+    }
+    if (slot.nextFree != -1) {
+        slots[slot.nextFree].prevFree = slot.prevFree;
+    }
+    slot.prevFree = slot.nextFree = -1;
+    slot.alive = true;
+    return index;
+}
+
+template<typename Slot>
+void GraphStore::releaseSlot(std::vector<Slot> &slots, int &freeHead, int index) {
+    Slot &slot = slots[index];
+    slot.alive = false;
+    slot.prevFree = -1;
+    slot.nextFree = freeHead;
+    if (freeHead != -1) {
+        slots[freeHead].prevFree = index;
+    }
+    freeHead = index;
+}
+
+void GraphStore::clear() {
+    nodes.clear();
+    edges.clear();
+    freeNode = -1;
+    freeEdge = -1;
+    liveNodes = 0;
+    liveEdges = 0;
+    groups.clear();
+}
+
+NodeHandle GraphStore::addNode() {
+    return insertNodeAt(-1);
+}
+
+NodeHandle GraphStore::insertNodeAt(int index) {
+    IM_ASSERT(index >= -1 && !nodeAlive(index));
+    index = allocSlot(nodes, freeNode, index);
+    nodes[index].firstIn = -1;
+    nodes[index].firstOut = -1;
+    nodes[index].group = -1;
+    ++liveNodes;
+    return nodeHandle(index);
+}
+
+bool GraphStore::removeNode(NodeHandle node) {
+    if (!isValid(node)) {
+        return false;
+    }
+    removeNodeAt(node.index);
+    return true;
+}
+
+void GraphStore::removeNodeAt(int index) {
+    IM_ASSERT(nodeAlive(index));
+    IM_ASSERT(!isGroup(index)); // expand the group first, removing it would not be undoable
+    NodeSlot &slot = nodes[index];
+    while (slot.firstOut != -1) {
+        removeEdgeAt(slot.firstOut);
+    }
+    while (slot.firstIn != -1) {
+        removeEdgeAt(slot.firstIn);
+    }
+    ++slot.generation;
+    releaseSlot(nodes, freeNode, index);
+    --liveNodes;
+}
+
+bool GraphStore::isValid(NodeHandle node) const {
+    return nodeAlive(node.index) && nodes[node.index].generation == node.generation;
+}
+
+bool GraphStore::nodeAlive(int index) const {
+    return index >= 0 && index < (int)nodes.size() && nodes[index].alive;
+}
+
+NodeHandle GraphStore::nodeHandle(int index) const {
+    NodeHandle handle;
+    if (nodeAlive(index)) {
+        handle.index = index;
+        handle.generation = nodes[index].generation;
+    }
+    return handle;
+}
+
+EdgeHandle GraphStore::addEdge(int sourceNode, int sourceSlot, int sinkNode, int sinkSlot) {
+    return insertEdgeAt(-1, Edge{ sourceNode, sourceSlot, sinkNode, sinkSlot });
+}
+
+EdgeHandle GraphStore::insertEdgeAt(int index, Edge const &edge) {
+    IM_ASSERT(nodeAlive(edge.sourceNode) && nodeAlive(edge.sinkNode));
+    IM_ASSERT(index >= -1 && !edgeAlive(index));
+    index = allocSlot(edges, freeEdge, index);
+    edges[index].edge = edge;
+    edges[index].hidden = false;
+    linkEdge(index);
+    ++liveEdges;
+    return edgeHandle(index);
+}
+
+// Pushes the edge to the front of the adjacency lists of both ends.
+void GraphStore::linkEdge(int index) {
+    EdgeSlot &slot = edges[index];
+    NodeSlot &source = nodes[slot.edge.sourceNode];
+    slot.prevOut = -1;
+    slot.nextOut = source.firstOut;
+    if (source.firstOut != -1) {
+        edges[source.firstOut].prevOut = index;
+    }
+    source.firstOut = index;
+
+    NodeSlot &sink = nodes[slot.edge.sinkNode];
+    slot.prevIn = -1;
+    slot.nextIn = sink.firstIn;
+    if (sink.firstIn != -1) {
+        edges[sink.firstIn].prevIn = index;
+    }
+    sink.firstIn = index;
+}
+
+EdgeHandle GraphStore::connect(int sourceNode, int sourceSlot, int sinkNode, int sinkSlot) {
+    int replaced = findIncoming(sinkNode, sinkSlot);
+    if (replaced != -1) {
+        removeEdgeAt(replaced);
+    }
+    return addEdge(sourceNode, sourceSlot, sinkNode, sinkSlot);
+}
+
+bool GraphStore::removeEdge(EdgeHandle edge) {
+    if (!isValid(edge)) {
+        return false;
+    }
+    removeEdgeAt(edge.index);
+    return true;
+}
+
+void GraphStore::removeEdgeAt(int index) {
+    IM_ASSERT(edgeAlive(index));
+    EdgeSlot &slot = edges[index];
+
+    if (slot.prevOut != -1) {
+        edges[slot.prevOut].nextOut = slot.nextOut;
+    } else {
+        nodes[slot.edge.sourceNode].firstOut = slot.nextOut;
+    }
+    if (slot.nextOut != -1) {
+        edges[slot.nextOut].prevOut = slot.prevOut;
+    }
+
+    if (slot.prevIn != -1) {
+        edges[slot.prevIn].nextIn = slot.nextIn;
+    } else {
+        nodes[slot.edge.sinkNode].firstIn = slot.nextIn;
+    }
+    if (slot.nextIn != -1) {
+        edges[slot.nextIn].prevIn = slot.prevIn;
+    }
+
+    ++slot.generation;
+    slot.prevOut = slot.nextOut = slot.prevIn = slot.nextIn = -1;
+    releaseSlot(edges, freeEdge, index);
+    --liveEdges;
+}
+
+bool GraphStore::isValid(EdgeHandle edge) const {
+    return edgeAlive(edge.index) && edges[edge.index].generation == edge.generation;
+}
+
+bool GraphStore::edgeAlive(int index) const {
+    return index >= 0 && index < (int)edges.size() && edges[index].alive;
+}
+
+EdgeHandle GraphStore::edgeHandle(int index) const {
+    EdgeHandle handle;
+    if (edgeAlive(index)) {
+        handle.index = index;
+        handle.generation = edges[index].generation;
+    }
+    return handle;
+}
+
+int GraphStore::findIncoming(int sinkNode, int sinkSlot) const {
+    if (!nodeAlive(sinkNode)) {
+        return -1;
+    }
+    for (int e = nodes[sinkNode].firstIn; e != -1; e = edges[e].nextIn) {
+        if (edges[e].edge.sinkSlot == sinkSlot && !edges[e].hidden) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+void GraphStore::removeSelected(NodeArea::Selection const &selectedNodes, NodeArea::Selection const &selectedEdges,
+    std::function<void(int)> const &nodeRemoved) {
+    int edgeEnd = std::min((int)selectedEdges.selectedItems.size(), (int)edges.size());
+    for (int i = 0; i < edgeEnd; ++i) {
+        if (selectedEdges.selectedItems[i] && edges[i].alive) {
+            removeEdgeAt(i);
+        }
+    }
+    int nodeEnd = std::min((int)selectedNodes.selectedItems.size(), (int)nodes.size());
+    for (int i = 0; i < nodeEnd; ++i) {
+        if (selectedNodes.selectedItems[i] && nodes[i].alive && !isGroup(i)) {
+            if (nodeRemoved) {
+                nodeRemoved(i);
+            }
+            removeNodeAt(i);
+        }
+    }
+}
+
+namespace {
+
+int findPort(std::vector<GraphStore::Port> &ports, NodeHandle node, int slot) {
+    for (int i = 0; i < (int)ports.size(); ++i) {
+        if (ports[i].node.index == node.index && ports[i].slot == slot) {
+            return i;
+        }
+    }
+    ports.push_back(GraphStore::Port{ node, slot });
+    return (int)ports.size() - 1;
+}
+
+} // unnamed namespace
+
+NodeHandle GraphStore::collapse(std::vector<int> const &members) {
+    std::vector<int> accepted;
+    for (int member : members) {
+        if (nodeAlive(member) && !nodeHidden(member)) {
+            accepted.push_back(member);
+        }
+    }
+    if (accepted.empty()) {
+        return NodeHandle();
+    }
+    NodeHandle proxy = addNode();
+    Group group;
+    for (int member : accepted) {
+        nodes[member].group = proxy.index;
+        group.members.push_back(nodeHandle(member));
+    }
+
+    // edges leaving a member: internal ones (both ends in the group) are hidden as they are,
+    // boundary ones are rerouted from a proxy output. Edges entering from outside are rerouted
+    // to a proxy input. Proxy edges only link the proxy and outside nodes, so the member lists
+    // walked here do not change.
+    for (int member : accepted) {
+        for (int e = nodes[member].firstOut; e != -1; e = edges[e].nextOut) {
+            if (edges[e].hidden) {
+                continue;
+            }
+            Edge edge = edges[e].edge;
+            EdgeHandle standIn;
+            if (nodes[edge.sinkNode].group != proxy.index) {
+                int port = findPort(group.outputs, nodeHandle(member), edge.sourceSlot);
+                standIn = addEdge(proxy.index, port, edge.sinkNode, edge.sinkSlot);
+            }
+            edges[e].hidden = true;
+            group.hiddenEdges.push_back(edgeHandle(e));
+            group.proxyEdges.push_back(standIn);
+        }
+        for (int e = nodes[member].firstIn; e != -1; e = edges[e].nextIn) {
+            Edge edge = edges[e].edge;
+            if (edges[e].hidden || nodes[edge.sourceNode].group == proxy.index) {
+                continue;
+            }
+            int port = findPort(group.inputs, nodeHandle(member), edge.sinkSlot);
+            EdgeHandle standIn = addEdge(edge.sourceNode, edge.sourceSlot, proxy.index, port);
+            edges[e].hidden = true;
+            group.hiddenEdges.push_back(edgeHandle(e));
+            group.proxyEdges.push_back(standIn);
+        }
+    }
+    groups[proxy.index] = std::move(group);
+    return proxy;
+}
+
+bool GraphStore::expand(int proxy) {
+    auto found = groups.find(proxy);
+    if (found == groups.end()) {
+        return false;
+    }
+    Group group = std::move(found->second);
+    groups.erase(found);
+
+    for (NodeHandle member : group.members) {
+        if (isValid(member)) {
+            nodes[member.index].group = -1;
+        }
+    }
+    // hidden edges come back unless their stand-in was removed while collapsed
+    std::vector<bool> standIn(edges.size(), false);
+    for (size_t i = 0; i < group.hiddenEdges.size(); ++i) {
+        EdgeHandle hidden = group.hiddenEdges[i];
+        EdgeHandle proxyEdge = group.proxyEdges[i];
+        if (!isValid(hidden)) {
+            continue;
+        }
+        if (proxyEdge.index == -1 || isValid(proxyEdge)) {
+            edges[hidden.index].hidden = false;
+        } else {
+            removeEdgeAt(hidden.index);
+        }
+        if (isValid(proxyEdge)) {
+            standIn[proxyEdge.index] = true;
+        }
+    }
+    // edges connected to the proxy by the user move to the member slots they stand for
+    std::vector<Edge> added;
+    for (int e = nodes[proxy].firstOut; e != -1; e = edges[e].nextOut) {
+        Edge edge = edges[e].edge;
+        if (!standIn[e] && edge.sourceSlot < (int)group.outputs.size() && isValid(group.outputs[edge.sourceSlot].node)) {
+            Port const &port = group.outputs[edge.sourceSlot];
+            added.push_back(Edge{ port.node.index, port.slot, edge.sinkNode, edge.sinkSlot });
+        }
+    }
+    for (int e = nodes[proxy].firstIn; e != -1; e = edges[e].nextIn) {
+        Edge edge = edges[e].edge;
+        if (!standIn[e] && edge.sinkSlot < (int)group.inputs.size() && isValid(group.inputs[edge.sinkSlot].node)) {
+            Port const &port = group.inputs[edge.sinkSlot];
+            added.push_back(Edge{ edge.sourceNode, edge.sourceSlot, port.node.index, port.slot });
+        }
+    }
+    removeNodeAt(proxy);
+    for (Edge const &edge : added) {
+        if (nodeAlive(edge.sourceNode) && nodeAlive(edge.sinkNode)) {
+            connect(edge.sourceNode, edge.sourceSlot, edge.sinkNode, edge.sinkSlot);
+        }
+    }
+    return true;
+}
+
+GraphStore::Group const *GraphStore::group(int proxy) const {
+    auto found = groups.find(proxy);
+    return found != groups.end() ? &found->second : nullptr;
+}
+
+NodeHandle CollapseSelection(NodeArea &area, GraphStore &graph, ImVec2 *proxyPos) {
+    NodeArea::InternalState &state = area.state;
+    std::vector<int> members;
+    int selectionEnd = std::min((int)state.selectedNodes.selectedItems.size(), graph.nodeSlotCount());
+    for (int i = 0; i < selectionEnd; ++i) {
+        if (state.selectedNodes.selectedItems[i] && graph.nodeAlive(i) && !graph.nodeHidden(i)) {
+            members.push_back(i);
+        }
+    }
+    ImVec2 pos(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    for (int member : members) {
+        if (member < state.graphBounds.leafCount) {
+            ImVec4 const &rect = state.graphBounds.rect(member);
+            pos = ImVec2(std::min(pos.x, rect.x), std::min(pos.y, rect.y));
+        }
+    }
+    NodeHandle proxy = graph.collapse(members);
+    if (proxy.index == -1) {
+        return proxy;
+    }
+    for (int member : members) {
+        area.ForgetNode(member);
+    }
+    state.selectedNodes.clearSelection();
+    state.selectedEdges.clearSelection();
+    state.selectedNodes.addToSelection(proxy.index);
+    if (proxyPos) {
+        *proxyPos = pos.x != std::numeric_limits<float>::max() ? pos : ImVec2();
+    }
+    return proxy;
+}
+
+bool ExpandGroup(NodeArea &area, GraphStore &graph, int proxy, std::function<NodeState*(int)> const &node) {
+    GraphStore::Group const *group = graph.group(proxy);
+    if (!group) {
+        return false;
+    }
+    IM_ASSERT(node);
+    std::vector<NodeHandle> members = group->members;
+    graph.expand(proxy);
+    area.ForgetNode(proxy);
+    area.state.selectedNodes.clearSelection();
+    area.state.selectedEdges.clearSelection();
+    for (NodeHandle member : members) {
+        if (!graph.isValid(member)) {
+            continue;
+        }
+        area.state.selectedNodes.addToSelection(member.index);
+        // the members were forgotten on collapse, this puts them back into the node index
+        NodeState *state = node(member.index);
+        IM_ASSERT(state && state->id == member.index);
+        area.Invalidate(*state);
+    }
+    area.Invalidate();
+    return true;
+}
+
+} // namespace nodes
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "imgui_nodes.hpp"
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+namespace nodes {
+
+// Generational handles into a GraphStore. index is the slot of the node/edge and is what gets
+// passed to NodeArea as NodeState::id or edge id. generation is bumped whenever the slot is
+// freed, so handles to removed items are detected even after their slot has been reused.
+struct NodeHandle {
+    int index = -1;
+    unsigned generation = 0;
+};
+
+struct EdgeHandle {
+    int index = -1;
+    unsigned generation = 0;
+};
+
+// Optional graph topology storage. Nodes and edges live in slot maps with free lists, every
+// node keeps intrusive lists of its incoming and outgoing edges. Adding and removing edges is
+// O(1), removing a node is O(degree). Node payloads (e.g. the NodeState and user data) are kept
+// by the application in arrays indexed by the node slot, see nodeSlotCount().
+class GraphStore {
+public:
+    struct Edge {
+        int sourceNode;
+        int sourceSlot;
+        int sinkNode;
+        int sinkSlot;
+    };
+
+    void clear();
+
+    NodeHandle addNode();
+    // Revives the given free slot, e.g. to restore a removed node with its old id.
+    NodeHandle insertNodeAt(int index);
+    // Removes the node and all its edges. Returns false for stale handles.
+    bool removeNode(NodeHandle node);
+    void removeNodeAt(int index);
+
+    bool isValid(NodeHandle node) const;
+    bool nodeAlive(int index) const;
+    NodeHandle nodeHandle(int index) const;
+    int nodeSlotCount() const { return (int)nodes.size(); }
+    int nodeCount() const { return liveNodes; }
+
+    EdgeHandle addEdge(int sourceNode, int sourceSlot, int sinkNode, int sinkSlot);
+    EdgeHandle insertEdgeAt(int index, Edge const &edge);
+    // Adds an edge, replacing the edge already connected to the sink slot (if any).
+    EdgeHandle connect(int sourceNode, int sourceSlot, int sinkNode, int sinkSlot);
+    bool removeEdge(EdgeHandle edge);
+    void removeEdgeAt(int index);
+
+    bool isValid(EdgeHandle edge) const;
+    bool edgeAlive(int index) const;
+    EdgeHandle edgeHandle(int index) const;
+    Edge const &edge(int index) const { return edges[index].edge; }
+    int edgeSlotCount() const { return (int)edges.size(); }
+    int edgeCount() const { return liveEdges; }
+
+    // Edge connected to the given input slot or -1. O(in-degree of the sink node).
+    int findIncoming(int sinkNode, int sinkSlot) const;
+
+    // Adjacency iteration, -1 terminates:
+    // for (int e = store.firstOutgoing(node); e != -1; e = store.nextOutgoing(e)) ...
+    int firstOutgoing(int node) const { return nodes[node].firstOut; }
+    int nextOutgoing(int edge) const { return edges[edge].nextOut; }
+    int firstIncoming(int node) const { return nodes[node].firstIn; }
+    int nextIncoming(int edge) const { return edges[edge].nextIn; }
+
+    // Removes the selected edges and nodes (selections indexed by slot, as used by NodeArea)
+    // in one pass. nodeRemoved is called for every removed node before its slot is freed.
+    // Does not clear the selections.
+    void removeSelected(NodeArea::Selection const &selectedNodes, NodeArea::Selection const &selectedEdges,
+        std::function<void(int)> const &nodeRemoved = nullptr);
+
+    // Groups. collapse hides a set of nodes behind a new proxy node: edges between the members
+    // are hidden, edges crossing the boundary are hidden and replaced by edges to the proxy. The
+    // proxy gets one input slot per member input fed from outside and one output slot per member
+    // output leading outside (see Group::inputs/outputs). Hidden nodes and edges stay alive but
+    // are not meant to be submitted to the NodeArea, skip them with nodeHidden/edgeHidden.
+    // expand restores the group and removes the proxy; edges connected to the proxy while it was
+    // collapsed are moved to the member slots they stand for, boundary edges removed from the
+    // proxy are removed for good. Groups nest. A proxy node cannot be removed (undo has no record
+    // of groups), expand it first; removeSelected skips selected proxies.
+    struct Port {
+        NodeHandle node;
+        int slot;
+    };
+    struct Group {
+        std::vector<NodeHandle> members;
+        std::vector<Port> inputs;   // by proxy input slot
+        std::vector<Port> outputs;  // by proxy output slot
+        std::vector<EdgeHandle> hiddenEdges;
+        std::vector<EdgeHandle> proxyEdges; // stand-in of hiddenEdges[i], invalid for internal edges
+    };
+
+    // Returns an invalid handle if none of members is alive and visible.
+    NodeHandle collapse(std::vector<int> const &members);
+    bool expand(int proxy);
+    bool isGroup(int index) const { return groups.count(index) != 0; }
+    Group const *group(int proxy) const;
+    // Proxy of the innermost collapsed group containing the node, -1 if visible.
+    int groupOf(int index) const { return nodes[index].group; }
+    bool nodeHidden(int index) const { return nodes[index].group != -1; }
+    bool edgeHidden(int index) const { return edges[index].hidden; }
+
+private:
+    // Free slots form a doubly linked list so that insertNodeAt/insertEdgeAt can take any of
+    // them in O(1).
+    struct NodeSlot {
+        unsigned generation = 0;
+        bool alive = false;
+        int firstIn = -1;
+        int firstOut = -1;
+        int group = -1;
+        int prevFree = -1, nextFree = -1;
+    };
+
+    struct EdgeSlot {
+        Edge edge;
+        unsigned generation = 0;
+        bool alive = false;
+        bool hidden = false;
+        int prevOut = -1, nextOut = -1;
+        int prevIn = -1, nextIn = -1;
+        int prevFree = -1, nextFree = -1;
+    };
+
+    template<typename Slot> static int allocSlot(std::vector<Slot> &slots, int &freeHead, int index);
+    template<typename Slot> static void releaseSlot(std::vector<Slot> &slots, int &freeHead, int index);
+    void linkEdge(int index);
+
+    std::vector<NodeSlot> nodes;
+    std::vector<EdgeSlot> edges;
+    int freeNode = -1;
+    int freeEdge = -1;
+    int liveNodes = 0;
+    int liveEdges = 0;
+    std::unordered_map<int, Group> groups;  // by proxy node
+};
+
+// Collapses the selected nodes of area into a new proxy node (see GraphStore::collapse). The
+// members are forgotten by the node area (no windows, bounds or culling work while collapsed)
+// and the proxy becomes the selection. proxyPos (optional) receives the top left corner of the
+// member bounds for placing the NodeState of the proxy, which the application creates.
+NodeHandle CollapseSelection(NodeArea &area, GraphStore &graph, ImVec2 *proxyPos = nullptr);
+
+// Expands a group, forgets its proxy and selects the members. node has to return the NodeState
+// of every member: the members are invalidated with it, which also puts them back into the index
+// used by NodeArea::SubmitNodes.
+bool ExpandGroup(NodeArea &area, GraphStore &graph, int proxy, std::function<NodeState*(int)> const &node);
+
+} // namespace nodes
@@ -0,0 +1,682 @@
+#include "imgui_nodes_layout.hpp"
+#include "imgui_nodes_threads.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace nodes {
+
+namespace {
+
+const ImVec2 defaultNodeSize = ImVec2(120.f, 60.f);    // for nodes which were not measured yet
+const float minCellHalf = 0.5f;                        // below this, bodies are aggregated
+const int layoutGrain = 256;
+
+} // unnamed namespace
+
+void ForceLayout::parallelFor(int count, std::function<void(int, int, int)> const &fn) {
+    if (threadPool) {
+        threadPool->parallelFor(count, layoutGrain, fn);
+    } else if (count > 0) {
+        fn(0, count, 0);
+    }
+}
+
+void ForceLayout::setGraph(GraphStore const &graph, std::function<NodeState*(int)> const &nodeFn) {
+    node = nodeFn;
+    ids.clear();
+    std::vector<int> body(graph.nodeSlotCount(), -1);
+    for (int i = 0; i < graph.nodeSlotCount(); ++i) {
+        if (graph.nodeAlive(i) && node(i)) {
+            body[i] = (int)ids.size();
+            ids.push_back(i);
+        }
+    }
+
+    int count = (int)ids.size();
+    x.resize(count); y.resize(count);
+    vx.assign(count, 0.f); vy.assign(count, 0.f);
+    fx.resize(count); fy.resize(count);
+    extent.resize(count);
+    halfSize.resize(count);
+    pinned.assign(count, false);
+    for (int b = 0; b < count; ++b) {
+        NodeState const &state = *node(ids[b]);
+        ImVec2 size = state.size.x > 0.f && state.size.y > 0.f ? state.size : defaultNodeSize;
+        halfSize[b] = ImVec2(size.x * 0.5f, size.y * 0.5f);
+        extent[b] = std::max(halfSize[b].x, halfSize[b].y);
+        x[b] = state.pos.x + halfSize[b].x;
+        y[b] = state.pos.y + halfSize[b].y;
+    }
+
+    // undirected adjacency in CSR form, springs are evaluated per body without write conflicts
+    adjacencyOffsets.assign(count + 1, 0);
+    for (int b = 0; b < count; ++b) {
+        for (int e = graph.firstOutgoing(ids[b]); e != -1; e = graph.nextOutgoing(e)) {
+            int other = body[graph.edge(e).sinkNode];
+            if (other != -1 && other != b) {
+                ++adjacencyOffsets[b + 1];
+                ++adjacencyOffsets[other + 1];
+            }
+        }
+    }
+    for (int b = 0; b < count; ++b) {
+        adjacencyOffsets[b + 1] += adjacencyOffsets[b];
+    }
+    adjacency.resize(adjacencyOffsets[count]);
+    std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (int b = 0; b < count; ++b) {
+        for (int e = graph.firstOutgoing(ids[b]); e != -1; e = graph.nextOutgoing(e)) {
+            int other = body[graph.edge(e).sinkNode];
+            if (other != -1 && other != b) {
+                adjacency[fill[b]++] = other;
+                adjacency[fill[other]++] = b;
+            }
+        }
+    }
+
+    maxStep = initialStep;
+    lastMove = std::numeric_limits<float>::max();
+    iterationCount = 0;
+    isSettled = count == 0;
+}
+
+void ForceLayout::scatter(ImVec2 center) {
+    // breadth first order, so that connected nodes start close to each other instead of having
+    // to untangle across the whole layout
+    int count = (int)ids.size();
+    std::vector<int> order;
+    order.reserve(count);
+    std::vector<bool> visited(count, false);
+    for (int root = 0; root < count; ++root) {
+        if (visited[root]) {
+            continue;
+        }
+        visited[root] = true;
+        order.push_back(root);
+        for (size_t next = order.size() - 1; next < order.size(); ++next) {
+            int b = order[next];
+            for (int k = adjacencyOffsets[b]; k < adjacencyOffsets[b + 1]; ++k) {
+                if (!visited[adjacency[k]]) {
+                    visited[adjacency[k]] = true;
+                    order.push_back(adjacency[k]);
+                }
+            }
+        }
+    }
+
+    // sunflower spiral, evenly spaced without coincident points
+    const float goldenAngle = 2.39996323f;
+    for (int i = 0; i < count; ++i) {
+        int b = order[i];
+        float radius = (springLength + 2.f * extent[b]) * 0.5f * std::sqrt((float)i);
+        x[b] = center.x + radius * std::cos(i * goldenAngle);
+        y[b] = center.y + radius * std::sin(i * goldenAngle);
+        vx[b] = vy[b] = 0.f;
+    }
+    maxStep = initialStep;
+    lastMove = std::numeric_limits<float>::max();
+    isSettled = ids.empty();
+}
+
+void ForceLayout::insert(int b) {
+    int c = 0;
+    for (;;) {
+        if (cells[c].child == -1) {
+            if (cells[c].mass == 0.f) {
+                cells[c].body = b;
+                cells[c].mass = 1.f;
+                cells[c].mx = x[b];
+                cells[c].my = y[b];
+                return;
+            }
+            if (cells[c].half < minCellHalf) {
+                // (nearly) coincident bodies, keep them as one aggregate
+                cells[c].mx = (cells[c].mx * cells[c].mass + x[b]) / (cells[c].mass + 1.f);
+                cells[c].my = (cells[c].my * cells[c].mass + y[b]) / (cells[c].mass + 1.f);
+                cells[c].mass += 1.f;
+                cells[c].body = -1;
+                return;
+            }
+            int first = (int)cells.size();
+            float half = cells[c].half * 0.5f;
+            for (int q = 0; q < 4; ++q) {
+                Cell child = { cells[c].cx + ((q & 1) ? half : -half), cells[c].cy + ((q & 2) ? half : -half), half, 0.f, 0.f, 0.f, -1, -1 };
+                cells.push_back(child);
+            }
+            cells[c].child = first;
+            int old = cells[c].body;
+            cells[c].body = -1;
+            if (old != -1) {
+                Cell &child = cells[first + ((x[old] >= cells[c].cx ? 1 : 0) | (y[old] >= cells[c].cy ? 2 : 0))];
+                child.body = old;
+                child.mass = 1.f;
+                child.mx = x[old];
+                child.my = y[old];
+            }
+        }
+        cells[c].mx = (cells[c].mx * cells[c].mass + x[b]) / (cells[c].mass + 1.f);
+        cells[c].my = (cells[c].my * cells[c].mass + y[b]) / (cells[c].mass + 1.f);
+        cells[c].mass += 1.f;
+        c = cells[c].child + ((x[b] >= cells[c].cx ? 1 : 0) | (y[b] >= cells[c].cy ? 2 : 0));
+    }
+}
+
+void ForceLayout::buildTree() {
+    float minX = std::numeric_limits<float>::max(), minY = minX;
+    float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+    for (int b = 0; b < (int)ids.size(); ++b) {
+        minX = std::min(minX, x[b]); maxX = std::max(maxX, x[b]);
+        minY = std::min(minY, y[b]); maxY = std::max(maxY, y[b]);
+    }
+    cells.clear();
+    cells.reserve(ids.size() * 2 + 1);
+    Cell root = { (minX + maxX) * 0.5f, (minY + maxY) * 0.5f, std::max(maxX - minX, maxY - minY) * 0.5f + 1.f, 0.f, 0.f, 0.f, -1, -1 };
+    cells.push_back(root);
+    for (int b = 0; b < (int)ids.size(); ++b) {
+        insert(b);
+    }
+}
+
+void ForceLayout::iterate() {
+    buildTree();
+
+    float theta2 = theta * theta;
+    float centerX = cells[0].mx;
+    float centerY = cells[0].my;
+    parallelFor((int)ids.size(), [&](int begin, int end, int) {
+        std::vector<int> stack;
+        stack.reserve(64);
+        for (int i = begin; i < end; ++i) {
+            float xi = x[i], yi = y[i];
+            float fxi = -gravity * (xi - centerX);
+            float fyi = -gravity * (yi - centerY);
+
+            // repulsion, distant cells act as one body at their center of mass
+            stack.clear();
+            stack.push_back(0);
+            while (!stack.empty()) {
+                Cell const &cell = cells[stack.back()];
+                stack.pop_back();
+                if (cell.mass == 0.f || cell.body == i) {
+                    continue;
+                }
+                float dx = cell.mx - xi;
+                float dy = cell.my - yi;
+                float d2 = dx * dx + dy * dy;
+                if (cell.child != -1 && 4.f * cell.half * cell.half >= theta2 * d2) {
+                    for (int q = 0; q < 4; ++q) {
+                        stack.push_back(cell.child + q);
+                    }
+                    continue;
+                }
+                float d = std::sqrt(d2);
+                // single bodies repel by their gap, so large nodes do not overlap
+                float gap = cell.body != -1 ? d - extent[i] - extent[cell.body] : d;
+                gap = std::max(gap, 1.f);
+                float f = repulsion * cell.mass / (gap * gap);
+                if (d > 1e-4f) {
+                    fxi -= dx / d * f;
+                    fyi -= dy / d * f;
+                } else {
+                    fxi += (i & 1) ? f : -f;
+                }
+            }
+
+            // springs along edges, stretched ones pull harder (quadratic like Fruchterman-Reingold)
+            for (int k = adjacencyOffsets[i]; k < adjacencyOffsets[i + 1]; ++k) {
+                int j = adjacency[k];
+                float dx = x[j] - xi;
+                float dy = y[j] - yi;
+                float d = std::sqrt(dx * dx + dy * dy) + 1e-4f;
+                float rest = springLength + extent[i] + extent[j];
+                float f = springStrength * (d - rest) * std::max(1.f, d / rest);
+                fxi += dx / d * f;
+                fyi += dy / d * f;
+            }
+
+            fx[i] = fxi;
+            fy[i] = fyi;
+        }
+    });
+
+    workerMove.assign(threadPool ? threadPool->workerCount() : 1, 0.f);
+    parallelFor((int)ids.size(), [&](int begin, int end, int worker) {
+        float move = 0.f;
+        for (int i = begin; i < end; ++i) {
+            if (pinned[i]) {
+                vx[i] = vy[i] = 0.f;
+                continue;
+            }
+            vx[i] = (vx[i] + fx[i]) * damping;
+            vy[i] = (vy[i] + fy[i]) * damping;
+            float length = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+            if (length > maxStep) {
+                vx[i] *= maxStep / length;
+                vy[i] *= maxStep / length;
+                length = maxStep;
+            }
+            x[i] += vx[i];
+            y[i] += vy[i];
+            move = std::max(move, length);
+        }
+        workerMove[worker] = std::max(workerMove[worker], move);
+    });
+
+    lastMove = *std::max_element(workerMove.begin(), workerMove.end());
+    maxStep *= cooling;
+    ++iterationCount;
+    isSettled = maxStep < minStep || lastMove < minStep;
+}
+
+bool ForceLayout::step(NodeArea &area, float budgetMs) {
+    if (isSettled) {
+        return false;
+    }
+
+    // nodes dragged by the user stay where they are put
+    bool dragging = area.state.mode == NodeArea::Mode::DraggingNodes;
+    for (int b = 0; b < (int)ids.size(); ++b) {
+        NodeState const *state = dragging && area.state.selectedNodes.isSelected(ids[b]) ? node(ids[b]) : nullptr;
+        pinned[b] = state != nullptr;
+        if (state) {
+            x[b] = state->pos.x + halfSize[b].x;
+            y[b] = state->pos.y + halfSize[b].y;
+        }
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    do {
+        iterate();
+    } while (!isSettled && std::chrono::duration<float, std::milli>(Clock::now() - start).count() < budgetMs);
+
+    for (int b = 0; b < (int)ids.size(); ++b) {
+        NodeState *state = pinned[b] ? nullptr : node(ids[b]);
+        if (!state) {
+            continue;
+        }
+        ImVec2 pos(x[b] - halfSize[b].x, y[b] - halfSize[b].y);
+        if (std::fabs(pos.x - state->pos.x) >= 0.5f || std::fabs(pos.y - state->pos.y) >= 0.5f) {
+            state->pos = state->posFloat = pos;
+            area.Invalidate(*state);
+        }
+    }
+    return !isSettled;
+}
+
+struct LayeredLayout::Job {
+    // input snapshot, bodies are numbered densely
+    std::vector<NodeHandle> nodes;
+    std::vector<ImVec2> size;
+    std::vector<std::pair<int, int>> edges;     // source body, sink body
+    float layerSpacing, nodeSpacing;
+    int crossingSweeps, placementRounds;
+    ImVec2 origin;
+
+    std::vector<ImVec2> pos;                    // result, top left corners
+    std::atomic<bool> cancelled;
+    std::atomic<bool> finished;
+
+    Job() : cancelled(false), finished(false) {}
+};
+
+void LayeredLayout::start(GraphStore const &graph, std::function<NodeState const*(int)> const &node) {
+    cancel();
+
+    std::shared_ptr<Job> next = std::make_shared<Job>();
+    std::vector<int> body(graph.nodeSlotCount(), -1);
+    for (int i = 0; i < graph.nodeSlotCount(); ++i) {
+        NodeState const *state = graph.nodeAlive(i) ? node(i) : nullptr;
+        if (state) {
+            body[i] = (int)next->nodes.size();
+            next->nodes.push_back(graph.nodeHandle(i));
+            next->size.push_back(state->size.x > 0.f && state->size.y > 0.f ? state->size : defaultNodeSize);
+        }
+    }
+    for (int i = 0; i < graph.edgeSlotCount(); ++i) {
+        if (graph.edgeAlive(i)) {
+            GraphStore::Edge const &edge = graph.edge(i);
+            int source = body[edge.sourceNode];
+            int sink = body[edge.sinkNode];
+            if (source != -1 && sink != -1 && source != sink) {
+                next->edges.push_back(std::make_pair(source, sink));
+            }
+        }
+    }
+    next->layerSpacing = layerSpacing;
+    next->nodeSpacing = nodeSpacing;
+    next->crossingSweeps = crossingSweeps;
+    next->placementRounds = placementRounds;
+    next->origin = origin;
+
+    job = next;
+    worker = std::thread([next]() {
+        compute(*next);
+        next->finished = true;
+    });
+}
+
+void LayeredLayout::cancel() {
+    if (job) {
+        job->cancelled = true;
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    job.reset();
+}
+
+bool LayeredLayout::poll(NodeArea &area, GraphStore const &graph, std::function<NodeState*(int)> const &node) {
+    if (!job || !job->finished) {
+        return false;
+    }
+    worker.join();
+    std::shared_ptr<Job> done;
+    done.swap(job);
+    if (done->cancelled) {
+        return false;
+    }
+    // nodes removed since start() are skipped (also if their slot was reused meanwhile), added
+    // ones keep their position
+    for (size_t b = 0; b < done->nodes.size(); ++b) {
+        NodeState *state = graph.isValid(done->nodes[b]) ? node(done->nodes[b].index) : nullptr;
+        if (state) {
+            state->pos = state->posFloat = done->pos[b];
+            area.Invalidate(*state);
+        }
+    }
+    return true;
+}
+
+void LayeredLayout::compute(Job &job) {
+    int count = (int)job.nodes.size();
+    job.pos.assign(count, job.origin);
+    if (count == 0) {
+        return;
+    }
+
+    // 1. cycle breaking (greedy heuristic of Eades, Lin and Smyth): repeatedly take sinks to the
+    // back and sources to the front of an ordering, otherwise the body with the largest surplus
+    // of outgoing edges to the front. Edges pointing backwards in the ordering are reversed.
+    std::vector<std::pair<int, int>> &edges = job.edges;
+    {
+        std::vector<int> outOffsets(count + 1, 0), inOffsets(count + 1, 0);
+        for (size_t e = 0; e < edges.size(); ++e) {
+            ++outOffsets[edges[e].first + 1];
+            ++inOffsets[edges[e].second + 1];
+        }
+        for (int b = 0; b < count; ++b) {
+            outOffsets[b + 1] += outOffsets[b];
+            inOffsets[b + 1] += inOffsets[b];
+        }
+        std::vector<int> outs(edges.size()), ins(edges.size());
+        {
+            std::vector<int> fillOut(outOffsets.begin(), outOffsets.end() - 1);
+            std::vector<int> fillIn(inOffsets.begin(), inOffsets.end() - 1);
+            for (size_t e = 0; e < edges.size(); ++e) {
+                outs[fillOut[edges[e].first]++] = edges[e].second;
+                ins[fillIn[edges[e].second]++] = edges[e].first;
+            }
+        }
+
+        std::vector<int> outDegree(count), inDegree(count);
+        std::vector<int> sinks, sources;
+        std::priority_queue<std::pair<int, int>> surplus;  // stale entries are skipped on pop
+        for (int b = 0; b < count; ++b) {
+            outDegree[b] = outOffsets[b + 1] - outOffsets[b];
+            inDegree[b] = inOffsets[b + 1] - inOffsets[b];
+            if (outDegree[b] == 0) {
+                sinks.push_back(b);
+            } else if (inDegree[b] == 0) {
+                sources.push_back(b);
+            } else {
+                surplus.push(std::make_pair(outDegree[b] - inDegree[b], b));
+            }
+        }
+
+        std::vector<int> order(count, -1);
+        int front = 0, back = count;
+        auto take = [&](int b, bool toFront) {
+            order[b] = toFront ? front++ : --back;
+            for (int k = inOffsets[b]; k < inOffsets[b + 1]; ++k) {
+                int u = ins[k];
+                if (order[u] == -1 && --outDegree[u] == 0) {
+                    sinks.push_back(u);
+                } else if (order[u] == -1) {
+                    surplus.push(std::make_pair(outDegree[u] - inDegree[u], u));
+                }
+            }
+            for (int k = outOffsets[b]; k < outOffsets[b + 1]; ++k) {
+                int v = outs[k];
+                if (order[v] == -1 && --inDegree[v] == 0) {
+                    sources.push_back(v);
+                } else if (order[v] == -1) {
+                    surplus.push(std::make_pair(outDegree[v] - inDegree[v], v));
+                }
+            }
+        };
+        while (front < back) {
+            if (!sinks.empty()) {
+                int b = sinks.back();
+                sinks.pop_back();
+                if (order[b] == -1) {
+                    take(b, false);
+                }
+            } else if (!sources.empty()) {
+                int b = sources.back();
+                sources.pop_back();
+                if (order[b] == -1) {
+                    take(b, true);
+                }
+            } else {
+                std::pair<int, int> top = surplus.top();
+                surplus.pop();
+                if (order[top.second] == -1 && top.first == outDegree[top.second] - inDegree[top.second]) {
+                    take(top.second, true);
+                }
+            }
+        }
+        for (size_t e = 0; e < edges.size(); ++e) {
+            if (order[edges[e].first] > order[edges[e].second]) {
+                std::swap(edges[e].first, edges[e].second);
+            }
+        }
+    }
+    if (job.cancelled) {
+        return;
+    }
+
+    // 2. longest path layering in topological order
+    std::vector<int> layer(count, 0);
+    {
+        std::vector<int> inDegree(count, 0);
+        std::vector<std::vector<int>> successors(count);
+        for (size_t e = 0; e < edges.size(); ++e) {
+            successors[edges[e].first].push_back(edges[e].second);
+            ++inDegree[edges[e].second];
+        }
+        std::vector<int> order;
+        order.reserve(count);
+        for (int b = 0; b < count; ++b) {
+            if (inDegree[b] == 0) {
+                order.push_back(b);
+            }
+        }
+        for (size_t next = 0; next < order.size(); ++next) {
+            int b = order[next];
+            for (int s : successors[b]) {
+                layer[s] = std::max(layer[s], layer[b] + 1);
+                if (--inDegree[s] == 0) {
+                    order.push_back(s);
+                }
+            }
+        }
+        // sources are pulled right next to their closest successor instead of all starting in
+        // the first layer, which shortens long edges
+        for (int b = 0; b < count; ++b) {
+            if (inDegree[b] == 0 && layer[b] == 0 && !successors[b].empty()) {
+                int closest = std::numeric_limits<int>::max();
+                for (int s : successors[b]) {
+                    closest = std::min(closest, layer[s]);
+                }
+                layer[b] = closest - 1;
+            }
+        }
+    }
+    if (job.cancelled) {
+        return;
+    }
+
+    // 3. split edges spanning several layers with dummy bodies, so all edges connect neighbouring layers
+    std::vector<int> up, down;          // edges as from (layer l) -> to (layer l + 1)
+    for (size_t e = 0; e < edges.size(); ++e) {
+        int from = edges[e].first;
+        for (int l = layer[from] + 1; l < layer[edges[e].second]; ++l) {
+            int dummy = (int)layer.size();
+            layer.push_back(l);
+            up.push_back(from);
+            down.push_back(dummy);
+            from = dummy;
+        }
+        up.push_back(from);
+        down.push_back(edges[e].second);
+    }
+    int total = (int)layer.size();
+    int layerCount = *std::max_element(layer.begin(), layer.end()) + 1;
+
+    std::vector<int> predOffsets(total + 1, 0), succOffsets(total + 1, 0);
+    for (size_t e = 0; e < up.size(); ++e) {
+        ++succOffsets[up[e] + 1];
+        ++predOffsets[down[e] + 1];
+    }
+    for (int b = 0; b < total; ++b) {
+        succOffsets[b + 1] += succOffsets[b];
+        predOffsets[b + 1] += predOffsets[b];
+    }
+    std::vector<int> preds(up.size()), succs(up.size());
+    {
+        std::vector<int> fillPred(predOffsets.begin(), predOffsets.end() - 1);
+        std::vector<int> fillSucc(succOffsets.begin(), succOffsets.end() - 1);
+        for (size_t e = 0; e < up.size(); ++e) {
+            succs[fillSucc[up[e]]++] = down[e];
+            preds[fillPred[down[e]]++] = up[e];
+        }
+    }
+
+    // 4. crossing minimisation: order the layers by the barycenter of their neighbours, alternately
+    // sweeping to the right (looking at predecessors) and to the left (successors)
+    std::vector<std::vector<int>> layers(layerCount);
+    for (int b = 0; b < total; ++b) {
+        layers[layer[b]].push_back(b);
+    }
+    std::vector<float> rank(total), key(total);
+    for (auto &l : layers) {
+        for (size_t i = 0; i < l.size(); ++i) {
+            rank[l[i]] = (float)i;
+        }
+    }
+    for (int sweep = 0; sweep < job.crossingSweeps && !job.cancelled; ++sweep) {
+        bool right = (sweep & 1) == 0;
+        std::vector<int> const &offsets = right ? predOffsets : succOffsets;
+        std::vector<int> const &neighbours = right ? preds : succs;
+        for (int n = 1; n < layerCount; ++n) {
+            std::vector<int> &l = layers[right ? n : layerCount - 1 - n];
+            for (int b : l) {
+                int begin = offsets[b], end = offsets[b + 1];
+                if (begin == end) {
+                    key[b] = rank[b];
+                    continue;
+                }
+                float sum = 0.f;
+                for (int k = begin; k < end; ++k) {
+                    sum += rank[neighbours[k]];
+                }
+                key[b] = sum / (end - begin);
+            }
+            std::stable_sort(l.begin(), l.end(), [&](int a, int b) { return key[a] < key[b]; });
+            for (size_t i = 0; i < l.size(); ++i) {
+                rank[l[i]] = (float)i;
+            }
+        }
+    }
+    if (job.cancelled) {
+        return;
+    }
+
+    // 5. coordinates: layers are columns as wide as their widest node, within a column nodes are
+    // pulled towards the centers of their neighbours while keeping their order and spacing
+    std::vector<float> height(total, 0.f);
+    for (int b = 0; b < count; ++b) {
+        height[b] = job.size[b].y;
+    }
+    std::vector<float> columnX(layerCount, 0.f);
+    {
+        std::vector<float> width(layerCount, 0.f);
+        for (int b = 0; b < count; ++b) {
+            width[layer[b]] = std::max(width[layer[b]], job.size[b].x);
+        }
+        for (int l = 1; l < layerCount; ++l) {
+            columnX[l] = columnX[l - 1] + width[l - 1] + job.layerSpacing;
+        }
+    }
+
+    std::vector<float> top(total);     // top edge, dummies are points
+    for (auto &l : layers) {
+        float y = 0.f;
+        for (int b : l) {
+            top[b] = y;
+            y += height[b] + job.nodeSpacing;
+        }
+    }
+    std::vector<float> forward, backward;
+    for (int round = 0; round < job.placementRounds * 2 && !job.cancelled; ++round) {
+        bool right = (round & 1) == 0;
+        std::vector<int> const &offsets = right ? predOffsets : succOffsets;
+        std::vector<int> const &neighbours = right ? preds : succs;
+        for (int n = 1; n < layerCount; ++n) {
+            std::vector<int> const &l = layers[right ? n : layerCount - 1 - n];
+            for (int b : l) {
+                int begin = offsets[b], end = offsets[b + 1];
+                if (begin != end) {
+                    float sum = 0.f;
+                    for (int k = begin; k < end; ++k) {
+                        sum += top[neighbours[k]] + height[neighbours[k]] * 0.5f;
+                    }
+                    key[b] = sum / (end - begin) - height[b] * 0.5f;
+                } else {
+                    key[b] = top[b];
+                }
+            }
+            // packing downwards and upwards both keep the spacing, so does their average; this
+            // avoids drifting into either direction
+            size_t size = l.size();
+            forward.resize(size);
+            backward.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                forward[i] = i == 0 ? key[l[i]] : std::max(key[l[i]], forward[i - 1] + height[l[i - 1]] + job.nodeSpacing);
+            }
+            for (size_t i = size; i-- > 0;) {
+                backward[i] = i + 1 == size ? key[l[i]] : std::min(key[l[i]], backward[i + 1] - height[l[i]] - job.nodeSpacing);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                top[l[i]] = (forward[i] + backward[i]) * 0.5f;
+            }
+        }
+    }
+
+    float minTop = std::numeric_limits<float>::max();
+    for (int b = 0; b < count; ++b) {
+        minTop = std::min(minTop, top[b]);
+    }
+    for (int b = 0; b < count; ++b) {
+        job.pos[b] = ImVec2(std::floor(job.origin.x + columnX[layer[b]]), std::floor(job.origin.y + top[b] - minTop));
+    }
+}
+
+} // namespace nodes
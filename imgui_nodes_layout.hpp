@@ -0,0 +1,112 @@
+#pragma once
+
+#include "imgui_nodes.hpp"
+#include "imgui_nodes_graph.hpp"
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+
+namespace nodes {
+
+class ThreadPool;
+
+// Incremental force directed layout. Nodes repel each other (Barnes-Hut approximation over a
+// quadtree, O(n log n) per iteration), edges pull their nodes together like springs. step() runs
+// as many iterations as fit into a time budget and writes the positions back, so the layout can
+// be animated inside the editor frame by frame until it settles.
+class ForceLayout {
+public:
+    float springLength = 80.f;      // rest length of an edge, added to the node extents
+    float springStrength = 0.06f;
+    float repulsion = 40000.f;
+    float gravity = 0.002f;         // pull towards the centroid, keeps components together
+    float theta = 0.8f;             // Barnes-Hut opening criterion, larger is faster and coarser
+    float damping = 0.8f;
+    float cooling = 0.995f;         // per iteration decay of the maximum step
+    float initialStep = 200.f;
+    float minStep = 0.5f;           // settled when the maximum step or all movement drops below this
+    std::shared_ptr<ThreadPool> threadPool;
+
+    // Takes the alive nodes of graph (positions and sizes from node, which may return null to
+    // leave a node out) and the edges between them. Restarts the simulation.
+    void setGraph(GraphStore const &graph, std::function<NodeState*(int)> const &node);
+
+    // Places all nodes on a spiral around center. Useful for imported graphs without positions.
+    void scatter(ImVec2 center);
+
+    // Runs iterations for about budgetMs milliseconds (at least one) and writes the new
+    // positions back, invalidating the nodes which moved. Nodes dragged by the user are pinned.
+    // Returns true while the layout is still moving.
+    bool step(NodeArea &area, float budgetMs);
+
+    bool settled() const { return isSettled; }
+    int iterations() const { return iterationCount; }
+
+private:
+    struct Cell {
+        float cx, cy, half;     // square bounds
+        float mass, mx, my;     // total mass and center of mass
+        int child;              // first of four consecutive children, -1 for leaves
+        int body;               // single body of a leaf, -1 if empty or aggregated
+    };
+
+    void iterate();
+    void buildTree();
+    void insert(int body);
+    void parallelFor(int count, std::function<void(int, int, int)> const &fn);
+
+    std::function<NodeState*(int)> node;
+    std::vector<int> ids;
+    std::vector<float> x, y, vx, vy, fx, fy, extent;
+    std::vector<ImVec2> halfSize;
+    std::vector<bool> pinned;
+    std::vector<int> adjacencyOffsets;
+    std::vector<int> adjacency;
+    std::vector<Cell> cells;
+    std::vector<float> workerMove;
+    float maxStep = 0.f;
+    float lastMove = 0.f;
+    int iterationCount = 0;
+    bool isSettled = true;
+};
+
+// Layered (Sugiyama style) layout for left to right dataflow graphs: edges run from the output
+// slots on the right of a node to input slots further right. Cycles are broken by reversing a
+// small set of edges (greedy feedback arc set), nodes are layered by longest path, crossings are
+// reduced by barycentric sweeps and nodes are placed by their sizes. The computation runs on a
+// background thread on a snapshot of the graph; poll() applies the result to all nodes at once.
+class LayeredLayout {
+public:
+    float layerSpacing = 80.f;      // horizontal gap between layers
+    float nodeSpacing = 24.f;       // vertical gap between nodes of a layer
+    int crossingSweeps = 8;
+    int placementRounds = 4;
+    ImVec2 origin = ImVec2(0.f, 0.f);
+
+    LayeredLayout() = default;
+    ~LayeredLayout() { cancel(); }
+
+    LayeredLayout(LayeredLayout const&) = delete;
+    LayeredLayout& operator=(LayeredLayout const&) = delete;
+
+    // Snapshots the alive nodes (node may return null to leave a node out) and their edges and
+    // starts the computation. A running computation is discarded.
+    void start(GraphStore const &graph, std::function<NodeState const*(int)> const &node);
+    void cancel();
+    bool running() const { return job != nullptr; }
+
+    // Call every frame from the ui thread with the graph passed to start(). Once the result is
+    // ready, moves all nodes still alive to their new positions, invalidates them and returns true.
+    bool poll(NodeArea &area, GraphStore const &graph, std::function<NodeState*(int)> const &node);
+
+private:
+    struct Job;
+    static void compute(Job &job);
+
+    std::shared_ptr<Job> job;
+    std::thread worker;
+};
+
+} // namespace nodes
@@ -0,0 +1,164 @@
+#include "imgui_nodes_queue.hpp"
+#include "imgui_nodes.hpp"
+
+namespace nodes {
+
+MutationQueue::MutationQueue()
+    : head(&stub)
+    , tail(&stub)
+{
+    stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+MutationQueue::~MutationQueue() {
+    Mutation mutation;
+    while (pop(mutation)) {
+    }
+    if (tail != &stub) {
+        delete tail;
+    }
+}
+
+void MutationQueue::post(Mutation const &mutation) {
+    Entry *entry = new Entry;
+    entry->next.store(nullptr, std::memory_order_relaxed);
+    entry->mutation = mutation;
+    // publish the entry as the new head, then link it behind the previous one. Between both
+    // steps the list is interrupted and pop reports empty until the link is stored.
+    Entry *previous = head.exchange(entry, std::memory_order_acq_rel);
+    previous->next.store(entry, std::memory_order_release);
+}
+
+bool MutationQueue::pop(Mutation &mutation) {
+    Entry *next = tail->next.load(std::memory_order_acquire);
+    if (!next) {
+        return false;
+    }
+    mutation = next->mutation;
+    // next becomes the new tail, whose mutation counts as consumed
+    if (tail != &stub) {
+        delete tail;
+    }
+    tail = next;
+    return true;
+}
+
+bool MutationQueue::empty() const {
+    return tail->next.load(std::memory_order_acquire) == nullptr;
+}
+
+int MutationQueue::drain(NodeArea &area, int budget) {
+    NodeArea::InternalState &state = area.state;
+    int applied = 0;
+    Mutation mutation;
+    while ((budget < 0 || applied < budget) && pop(mutation)) {
+        ++applied;
+        if (state.mutationHandler) {
+            state.mutationHandler(mutation);
+        }
+        switch (mutation.type) {
+        case Mutation::RemoveNode:
+            state.selectedNodes.removeFromSelection(mutation.id);
+            area.ForgetNode(mutation.id);
+            break;
+        case Mutation::MoveNode:
+        case Mutation::ResizeNode:
+            if (NodeState *node = state.mutationNode ? state.mutationNode(mutation.id) : nullptr) {
+                if (mutation.type == Mutation::MoveNode) {
+                    node->pos = node->posFloat = mutation.value;
+                } else {
+                    node->size = mutation.value;
+                }
+                area.Invalidate(*node);
+            }
+            break;
+        case Mutation::RemoveEdge:
+            state.selectedEdges.removeFromSelection(mutation.id);
+            break;
+        case Mutation::SelectNode:
+            state.selectedNodes.addToSelection(mutation.id);
+            break;
+        case Mutation::DeselectNode:
+            state.selectedNodes.removeFromSelection(mutation.id);
+            break;
+        case Mutation::ClearSelection:
+            state.selectedNodes.clearSelection();
+            state.selectedEdges.clearSelection();
+            break;
+        default:
+            break;
+        }
+    }
+    if (applied > 0) {
+        area.Invalidate();
+    }
+    return applied;
+}
+
+void MutationQueue::addNode(int id, ImVec2 pos, int userType, void *userData) {
+    Mutation mutation;
+    mutation.type = Mutation::AddNode;
+    mutation.id = id;
+    mutation.value = pos;
+    mutation.userType = userType;
+    mutation.userData = userData;
+    post(mutation);
+}
+
+void MutationQueue::removeNode(int id) {
+    Mutation mutation;
+    mutation.type = Mutation::RemoveNode;
+    mutation.id = id;
+    post(mutation);
+}
+
+void MutationQueue::moveNode(int id, ImVec2 pos) {
+    Mutation mutation;
+    mutation.type = Mutation::MoveNode;
+    mutation.id = id;
+    mutation.value = pos;
+    post(mutation);
+}
+
+void MutationQueue::resizeNode(int id, ImVec2 size) {
+    Mutation mutation;
+    mutation.type = Mutation::ResizeNode;
+    mutation.id = id;
+    mutation.value = size;
+    post(mutation);
+}
+
+void MutationQueue::addEdge(int id, int sourceNode, int sourceSlot, int sinkNode, int sinkSlot, int userType, void *userData) {
+    Mutation mutation;
+    mutation.type = Mutation::AddEdge;
+    mutation.id = id;
+    mutation.node = sourceNode;
+    mutation.slot = sourceSlot;
+    mutation.otherNode = sinkNode;
+    mutation.otherSlot = sinkSlot;
+    mutation.userType = userType;
+    mutation.userData = userData;
+    post(mutation);
+}
+
+void MutationQueue::removeEdge(int id) {
+    Mutation mutation;
+    mutation.type = Mutation::RemoveEdge;
+    mutation.id = id;
+    post(mutation);
+}
+
+void MutationQueue::selectNode(int id, bool selected) {
+    Mutation mutation;
+    mutation.type = selected ? Mutation::SelectNode : Mutation::DeselectNode;
+    mutation.id = id;
+    post(mutation);
+}
+
+void MutationQueue::clearSelection() {
+    Mutation mutation;
+    mutation.type = Mutation::ClearSelection;
+    post(mutation);
+}
+
+} // namespace nodes
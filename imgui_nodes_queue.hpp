@@ -0,0 +1,83 @@
+#pragma once
+
+#include <imgui.h>
+
+#include <atomic>
+
+namespace nodes {
+
+struct NodeArea;
+
+// A graph change posted from any thread, applied on the ui thread by MutationQueue::drain.
+struct Mutation {
+    enum Type {
+        AddNode,        // id, value (position), userType, userData
+        RemoveNode,     // id
+        MoveNode,       // id, value (position)
+        ResizeNode,     // id, value (size)
+        AddEdge,        // id, node/slot (source), otherNode/otherSlot (sink), userType, userData
+        RemoveEdge,     // id
+        SelectNode,     // id
+        DeselectNode,   // id
+        ClearSelection
+    };
+
+    Type type = ClearSelection;
+    int id = -1;
+    int node = -1;
+    int slot = -1;
+    int otherNode = -1;
+    int otherSlot = -1;
+    ImVec2 value;
+    int userType = 0;
+    void *userData = nullptr; // owned by the application, passed through untouched
+};
+
+// Unbounded lock-free multi producer, single consumer queue of Mutations (intrusive linked list
+// after Vyukov). Any number of threads may post, posting never waits for the ui thread. Set it as
+// NodeArea::state.mutationQueue to have BeginNodeArea drain it at the start of every frame, at
+// most state.mutationBudget mutations per frame, in posting order.
+//
+// The NodeArea applies what it owns: selection changes, ForgetNode for removed nodes and
+// position/size changes of the NodeStates returned by state.mutationNode (followed by
+// Invalidate). Every mutation is passed to state.mutationHandler first, which has to create and
+// delete nodes and edges in the application model.
+class MutationQueue {
+public:
+    MutationQueue();
+    ~MutationQueue();
+
+    MutationQueue(MutationQueue const&) = delete;
+    MutationQueue& operator=(MutationQueue const&) = delete;
+
+    // Producer side, callable from any thread.
+    void post(Mutation const &mutation);
+    void addNode(int id, ImVec2 pos, int userType = 0, void *userData = nullptr);
+    void removeNode(int id);
+    void moveNode(int id, ImVec2 pos);
+    void resizeNode(int id, ImVec2 size);
+    void addEdge(int id, int sourceNode, int sourceSlot, int sinkNode, int sinkSlot, int userType = 0, void *userData = nullptr);
+    void removeEdge(int id);
+    void selectNode(int id, bool selected = true);
+    void clearSelection();
+
+    // Consumer side, ui thread only. pop returns false if the queue is empty (or a post is still
+    // in flight). drain applies at most budget mutations (all if budget < 0) to area and returns
+    // the number applied.
+    bool pop(Mutation &mutation);
+    int drain(NodeArea &area, int budget);
+
+    bool empty() const;
+
+private:
+    struct Entry {
+        std::atomic<Entry*> next;
+        Mutation mutation;
+    };
+
+    std::atomic<Entry*> head;   // last posted entry, producers exchange it
+    Entry *tail;                // next entry to consume, its mutation was consumed already
+    Entry stub;
+};
+
+} // namespace nodes
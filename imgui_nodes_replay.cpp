@@ -0,0 +1,209 @@
+#include "imgui_nodes_replay.hpp"
+
+#include <imgui_internal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+namespace nodes {
+
+namespace {
+
+// File layout (native endianness):
+//   ReplayHeader
+//   per frame: FrameRecord, eventCount raw ImGuiInputEvents
+const char replayMagic[4] = { 'I', 'M', 'N', 'R' };
+const uint16_t replayVersion = 1;
+
+struct ReplayHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t eventSize;     // sizeof(ImGuiInputEvent)
+    uint32_t imguiVersion;  // IMGUI_VERSION_NUM
+};
+
+struct FrameRecord {
+    float deltaTime;
+    ImVec2 displaySize;
+    ImVec2 windowPos;
+    ImVec2 windowSize;
+    float zoom;
+    ImVec2 innerWndPos;
+    int32_t flags;
+    uint32_t eventCount;
+};
+
+} // unnamed namespace
+
+bool InputRecorder::start(char const *path) {
+    stop();
+    file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    ReplayHeader header;
+    std::memcpy(header.magic, replayMagic, 4);
+    header.version = replayVersion;
+    header.eventSize = (uint16_t)sizeof(ImGuiInputEvent);
+    header.imguiVersion = IMGUI_VERSION_NUM;
+    frameCount = 0;
+    failed = std::fwrite(&header, sizeof(ReplayHeader), 1, file) != 1;
+    return !failed;
+}
+
+bool InputRecorder::stop() {
+    if (!file) {
+        return !failed;
+    }
+    failed = std::fclose(file) != 0 || failed;
+    file = nullptr;
+    return !failed;
+}
+
+void InputRecorder::record(NodeArea const &area, ImVec2 windowPos, ImVec2 windowSize, NodeAreaFlags flags) {
+    if (!file) {
+        return;
+    }
+    ImGuiContext const &g = *ImGui::GetCurrentContext();
+    FrameRecord record;
+    record.deltaTime = g.IO.DeltaTime;
+    record.displaySize = g.IO.DisplaySize;
+    record.windowPos = windowPos;
+    record.windowSize = windowSize;
+    record.zoom = area.state.initialized ? area.state.zoom : 0.f;
+    record.innerWndPos = area.state.initialized ? area.state.innerWndPos : ImVec2();
+    record.flags = flags;
+    record.eventCount = (uint32_t)g.InputEventsTrail.size();
+    bool ok = std::fwrite(&record, sizeof(FrameRecord), 1, file) == 1;
+    if (record.eventCount > 0) {
+        ok = ok && std::fwrite(g.InputEventsTrail.Data, sizeof(ImGuiInputEvent), record.eventCount, file) == record.eventCount;
+    }
+    failed = failed || !ok;
+    ++frameCount;
+}
+
+InputPlayer::~InputPlayer() {
+    if (context) {
+        ImGuiContext *previous = ImGui::GetCurrentContext();
+        ImGui::DestroyContext(context);
+        ImGui::SetCurrentContext(previous != context ? previous : nullptr);
+    }
+}
+
+bool InputPlayer::open(char const *path) {
+    frames.clear();
+    events.clear();
+    std::FILE *file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    ReplayHeader header;
+    bool ok = std::fread(&header, sizeof(ReplayHeader), 1, file) == 1 &&
+        std::memcmp(header.magic, replayMagic, 4) == 0 && header.version == replayVersion &&
+        header.eventSize == sizeof(ImGuiInputEvent) && header.imguiVersion == IMGUI_VERSION_NUM;
+    FrameRecord record;
+    while (ok && std::fread(&record, sizeof(FrameRecord), 1, file) == 1) {
+        Frame frame;
+        frame.deltaTime = record.deltaTime;
+        frame.displaySize = record.displaySize;
+        frame.windowPos = record.windowPos;
+        frame.windowSize = record.windowSize;
+        frame.zoom = record.zoom;
+        frame.innerWndPos = record.innerWndPos;
+        frame.flags = record.flags;
+        frame.firstEvent = (int)(events.size() / sizeof(ImGuiInputEvent));
+        frame.eventCount = (int)record.eventCount;
+        size_t bytes = record.eventCount * sizeof(ImGuiInputEvent);
+        events.resize(events.size() + bytes);
+        ok = bytes == 0 || std::fread(events.data() + events.size() - bytes, 1, bytes, file) == bytes;
+        if (ok) {
+            frames.push_back(frame);
+        }
+    }
+    std::fclose(file);
+    if (!ok) {
+        frames.clear();
+        events.clear();
+    }
+    return ok;
+}
+
+bool InputPlayer::run(NodeArea &area, std::function<void(NodeArea&, NodeAreaFlags)> const &frame) {
+    if (frames.empty()) {
+        return false;
+    }
+    typedef std::chrono::steady_clock Clock;
+
+    ImGuiContext *previous = ImGui::GetCurrentContext();
+    if (!context) {
+        context = ImGui::CreateContext();
+        ImGui::SetCurrentContext(context);
+        ImGuiIO &io = ImGui::GetIO();
+        io.IniFilename = nullptr;
+        io.LogFilename = nullptr;
+        if (setupContext) {
+            setupContext(io);
+        }
+        unsigned char *pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
+    ImGui::SetCurrentContext(context);
+
+    frameMs.clear();
+    frameMs.reserve(frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        Frame const &recorded = frames[i];
+        ImGuiIO &io = ImGui::GetIO();
+        io.DeltaTime = recorded.deltaTime > 0.f ? recorded.deltaTime : 1.f / 60.f;
+        io.DisplaySize = recorded.displaySize;
+        ImGuiInputEvent const *recordedEvents = reinterpret_cast<ImGuiInputEvent const*>(events.data()) + recorded.firstEvent;
+        for (int e = 0; e < recorded.eventCount; ++e) {
+            context->InputEventsQueue.push_back(recordedEvents[e]);
+        }
+        if (i == 0 && recorded.zoom > 0.f) {
+            area.SetView(recorded.zoom, recorded.innerWndPos);
+        }
+
+        Clock::time_point start = Clock::now();
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(recorded.windowPos);
+        ImGui::SetNextWindowSize(recorded.windowSize);
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+        ImGui::Begin("##replay", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove |
+            ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoBringToFrontOnFocus);
+        ImGui::PopStyleVar();
+        frame(area, (NodeAreaFlags)recorded.flags);
+        ImGui::End();
+        ImGui::Render();
+        frameMs.push_back(std::chrono::duration<float, std::milli>(Clock::now() - start).count());
+    }
+
+    ImGui::SetCurrentContext(previous);
+    return true;
+}
+
+InputPlayer::Stats InputPlayer::stats() const {
+    Stats result;
+    result.frames = (int)frameMs.size();
+    if (frameMs.empty()) {
+        return result;
+    }
+    for (size_t i = 0; i < frameMs.size(); ++i) {
+        result.totalMs += frameMs[i];
+        if (frameMs[i] > result.maxMs) {
+            result.maxMs = frameMs[i];
+            result.maxFrame = (int)i;
+        }
+    }
+    result.meanMs = result.totalMs / (float)frameMs.size();
+    std::vector<float> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    result.medianMs = sorted[sorted.size() / 2];
+    result.p95Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+    return result;
+}
+
+} // namespace nodes
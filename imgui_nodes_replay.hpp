@@ -0,0 +1,101 @@
+#pragma once
+
+#include "imgui_nodes.hpp"
+
+#include <vector>
+#include <cstdio>
+#include <functional>
+
+struct ImGuiInputEvent;
+
+namespace nodes {
+
+// Records the input of a NodeArea for deterministic replay: per frame the delta time, the display
+// size, the geometry of the window hosting the node area, the view (zoom and inner window
+// position), the flags passed to BeginNodeArea and every input event of the outer context, which
+// is what the inner context receives. Set it as NodeArea::state.recorder, BeginNodeArea writes one
+// record per frame while recording.
+// Recordings are raw ImGuiInputEvents and only replay with the same ImGui version.
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder() { stop(); }
+
+    InputRecorder(InputRecorder const&) = delete;
+    InputRecorder& operator=(InputRecorder const&) = delete;
+
+    bool start(char const *path);
+    // Flushes and closes the file. Returns false if writing failed at any point.
+    bool stop();
+    bool recording() const { return file != nullptr; }
+    int frames() const { return frameCount; }
+
+    // Called by BeginNodeArea with the outer context current.
+    void record(NodeArea const &area, ImVec2 windowPos, ImVec2 windowSize, NodeAreaFlags flags);
+
+private:
+    std::FILE *file = nullptr;
+    int frameCount = 0;
+    bool failed = false;
+};
+
+// Replays a recording headless against a scripted graph and measures the cost of every frame.
+// The player owns an ImGui context without a backend (the font atlas is built, nothing is
+// rendered) in which each recorded frame is run: the recorded events are queued, a window is
+// placed at the recorded geometry and frame draws the graph into it (BeginNodeArea with the
+// passed flags, nodes, edges, EndNodeArea). The view of the first frame is restored with
+// NodeArea::SetView.
+// Use a fresh NodeArea which is destroyed before the player, its inner context shares the fonts
+// of the player context.
+class InputPlayer {
+public:
+    struct Stats {
+        int frames = 0;
+        float totalMs = 0.f;
+        float meanMs = 0.f;
+        float medianMs = 0.f;
+        float p95Ms = 0.f;
+        float maxMs = 0.f;
+        int maxFrame = -1;
+    };
+
+    // Optional, called once after the player context was created, e.g. to load the fonts used
+    // when recording.
+    std::function<void(ImGuiIO&)> setupContext;
+
+    InputPlayer() = default;
+    ~InputPlayer();
+
+    InputPlayer(InputPlayer const&) = delete;
+    InputPlayer& operator=(InputPlayer const&) = delete;
+
+    bool open(char const *path);
+    int frameCount() const { return (int)frames.size(); }
+
+    // Replays all frames. frameMs receives the time from NewFrame to Render of each frame.
+    // Returns false if no recording is open.
+    bool run(NodeArea &area, std::function<void(NodeArea&, NodeAreaFlags)> const &frame);
+
+    std::vector<float> const &frameTimes() const { return frameMs; }
+    Stats stats() const;
+
+private:
+    struct Frame {
+        float deltaTime;
+        ImVec2 displaySize;
+        ImVec2 windowPos;
+        ImVec2 windowSize;
+        float zoom;             // <= 0 if the node area was not initialized yet
+        ImVec2 innerWndPos;
+        int flags;
+        int firstEvent;
+        int eventCount;
+    };
+
+    std::vector<Frame> frames;
+    std::vector<unsigned char> events;  // raw ImGuiInputEvents
+    std::vector<float> frameMs;
+    ImGuiContext *context = nullptr;
+};
+
+} // namespace nodes
@@ -0,0 +1,485 @@
+#include "imgui_nodes_serialize.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace nodes {
+
+namespace {
+
+// Blob layout (native endianness):
+//   SubgraphHeader
+//   per node:  pos, size, sizeConstraintMin, sizeConstraintMax (ImVec2),
+//              inputCount, outputCount (uint32), slots (int32 type, ImVec2 pos relative to the node),
+//              payloadSize (uint32), payload
+//   per edge:  source (uint32 node record), sourceSlot (int32), sink (uint32 node record), sinkSlot (int32)
+const char subgraphMagic[4] = { 'I', 'M', 'N', 'D' };
+const uint16_t subgraphVersion = 1;
+
+struct SubgraphHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t nodeCount;
+    uint32_t edgeCount;
+    ImVec2 origin;      // top left corner of the copied node bounds
+};
+
+inline ImVec2 operator+(const ImVec2& lhs, const ImVec2& rhs) { return ImVec2(lhs.x + rhs.x, lhs.y + rhs.y); }
+inline ImVec2 operator-(const ImVec2& lhs, const ImVec2& rhs) { return ImVec2(lhs.x - rhs.x, lhs.y - rhs.y); }
+
+struct BlobWriter {
+    std::vector<unsigned char> &out;
+
+    template<typename T>
+    void put(T const &value) {
+        size_t offset = out.size();
+        out.resize(offset + sizeof(T));
+        std::memcpy(out.data() + offset, &value, sizeof(T));
+    }
+};
+
+struct BlobReader {
+    unsigned char const *p;
+    unsigned char const *end;
+    bool failed;
+
+    bool skip(size_t size) {
+        if (failed || (size_t)(end - p) < size) {
+            failed = true;
+            return false;
+        }
+        p += size;
+        return true;
+    }
+
+    template<typename T>
+    T get() {
+        T value = T();
+        unsigned char const *src = p;
+        if (skip(sizeof(T))) {
+            std::memcpy(&value, src, sizeof(T));
+        }
+        return value;
+    }
+};
+
+void writeSlots(BlobWriter &writer, std::vector<SlotState> const &slots, ImVec2 nodePos) {
+    for (SlotState const &slot : slots) {
+        writer.put((int32_t)slot.type);
+        writer.put(slot.pos - nodePos);
+    }
+}
+
+void readSlots(BlobReader &reader, std::vector<SlotState> &slots, uint32_t count, ImVec2 nodePos) {
+    slots.resize(count);
+    for (SlotState &slot : slots) {
+        slot.type = reader.get<int32_t>();
+        slot.pos = nodePos + reader.get<ImVec2>();
+    }
+}
+
+// Checks the record structure of a blob without creating anything, so that a broken blob does
+// not leave half pasted graphs behind.
+bool validateSubgraph(unsigned char const *data, size_t size) {
+    BlobReader reader = { data, data + size, false };
+    SubgraphHeader header = reader.get<SubgraphHeader>();
+    if (reader.failed || std::memcmp(header.magic, subgraphMagic, 4) != 0 || header.version != subgraphVersion) {
+        return false;
+    }
+    const size_t slotSize = sizeof(int32_t) + sizeof(ImVec2);
+    for (uint32_t i = 0; i < header.nodeCount && !reader.failed; ++i) {
+        reader.skip(4 * sizeof(ImVec2));
+        uint32_t inputs = reader.get<uint32_t>();
+        uint32_t outputs = reader.get<uint32_t>();
+        reader.skip(((size_t)inputs + outputs) * slotSize);
+        reader.skip(reader.get<uint32_t>());
+    }
+    for (uint32_t i = 0; i < header.edgeCount && !reader.failed; ++i) {
+        uint32_t source = reader.get<uint32_t>();
+        reader.get<int32_t>();
+        uint32_t sink = reader.get<uint32_t>();
+        reader.get<int32_t>();
+        if (source >= header.nodeCount || sink >= header.nodeCount) {
+            return false;
+        }
+    }
+    return !reader.failed;
+}
+
+const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+struct Base64Lookup {
+    signed char values[256];
+
+    Base64Lookup() {
+        std::memset(values, -1, sizeof(values));
+        for (int i = 0; i < 64; ++i) {
+            values[(unsigned char)base64Chars[i]] = (signed char)i;
+        }
+    }
+};
+
+} // unnamed namespace
+
+int CopySubgraph(NodeArea const &area, GraphStore const &graph, SubgraphHooks const &hooks, std::vector<unsigned char> &out) {
+    IM_ASSERT(hooks.node);
+    out.clear();
+
+    std::vector<int> ids;
+    std::vector<int> record(graph.nodeSlotCount(), -1);
+    ImVec2 origin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    std::vector<bool> const &selected = area.state.selectedNodes.selectedItems;
+    int end = std::min((int)selected.size(), graph.nodeSlotCount());
+    for (int i = 0; i < end; ++i) {
+        NodeState const *node = selected[i] && graph.nodeAlive(i) ? hooks.node(i) : nullptr;
+        if (node) {
+            record[i] = (int)ids.size();
+            ids.push_back(i);
+            origin.x = std::min(origin.x, node->pos.x);
+            origin.y = std::min(origin.y, node->pos.y);
+        }
+    }
+    if (ids.empty()) {
+        return 0;
+    }
+
+    BlobWriter writer = { out };
+    SubgraphHeader header;
+    std::memcpy(header.magic, subgraphMagic, 4);
+    header.version = subgraphVersion;
+    header.reserved = 0;
+    header.nodeCount = (uint32_t)ids.size();
+    header.edgeCount = 0;
+    header.origin = origin;
+    writer.put(header);
+
+    for (int id : ids) {
+        NodeState const &node = *hooks.node(id);
+        writer.put(node.pos);
+        writer.put(node.size);
+        writer.put(node.sizeConstraintMin);
+        writer.put(node.sizeConstraintMax);
+        writer.put((uint32_t)node.inputSlots.size());
+        writer.put((uint32_t)node.outputSlots.size());
+        writeSlots(writer, node.inputSlots, node.pos);
+        writeSlots(writer, node.outputSlots, node.pos);
+
+        size_t sizeOffset = out.size();
+        writer.put((uint32_t)0);
+        if (hooks.saveNode) {
+            hooks.saveNode(id, out);
+        }
+        uint32_t payloadSize = (uint32_t)(out.size() - sizeOffset - sizeof(uint32_t));
+        std::memcpy(out.data() + sizeOffset, &payloadSize, sizeof(uint32_t));
+    }
+
+    // only edges between copied nodes are internal to the subgraph
+    for (int id : ids) {
+        for (int e = graph.firstOutgoing(id); e != -1; e = graph.nextOutgoing(e)) {
+            GraphStore::Edge const &edge = graph.edge(e);
+            if (record[edge.sinkNode] != -1) {
+                writer.put((uint32_t)record[id]);
+                writer.put((int32_t)edge.sourceSlot);
+                writer.put((uint32_t)record[edge.sinkNode]);
+                writer.put((int32_t)edge.sinkSlot);
+                ++header.edgeCount;
+            }
+        }
+    }
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    return (int)ids.size();
+}
+
+int PasteSubgraph(NodeArea &area, GraphStore &graph, SubgraphHooks const &hooks, unsigned char const *data, size_t size,
+    ImVec2 pos, std::vector<int> *newNodes) {
+    IM_ASSERT(hooks.loadNode);
+    if (!data || !validateSubgraph(data, size)) {
+        return -1;
+    }
+
+    BlobReader reader = { data, data + size, false };
+    SubgraphHeader header = reader.get<SubgraphHeader>();
+
+    area.clearAllSelections();
+    std::vector<int> ids(header.nodeCount);
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        int id = graph.addNode().index;
+        ids[i] = id;
+
+        NodeState state(id, pos + (reader.get<ImVec2>() - header.origin));
+        state.size = reader.get<ImVec2>();
+        state.sizeConstraintMin = reader.get<ImVec2>();
+        state.sizeConstraintMax = reader.get<ImVec2>();
+        uint32_t inputs = reader.get<uint32_t>();
+        uint32_t outputs = reader.get<uint32_t>();
+        readSlots(reader, state.inputSlots, inputs, state.pos);
+        readSlots(reader, state.outputSlots, outputs, state.pos);
+
+        uint32_t payloadSize = reader.get<uint32_t>();
+        unsigned char const *payload = reader.p;
+        reader.skip(payloadSize);
+        hooks.loadNode(std::move(state), payload, payloadSize);
+
+        area.state.selectedNodes.addToSelection(id);
+    }
+
+    for (uint32_t i = 0; i < header.edgeCount; ++i) {
+        int source = ids[reader.get<uint32_t>()];
+        int sourceSlot = reader.get<int32_t>();
+        int sink = ids[reader.get<uint32_t>()];
+        int sinkSlot = reader.get<int32_t>();
+        graph.addEdge(source, sourceSlot, sink, sinkSlot);
+    }
+
+    area.Invalidate();
+    if (newNodes) {
+        newNodes->swap(ids);
+    }
+    return (int)header.nodeCount;
+}
+
+void EncodeBase64(unsigned char const *data, size_t size, std::string &out) {
+    out.clear();
+    out.reserve((size + 2) / 3 * 4);
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if (i + 1 < size) chunk |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) chunk |= (uint32_t)data[i + 2];
+        out.push_back(base64Chars[(chunk >> 18) & 63]);
+        out.push_back(base64Chars[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < size ? base64Chars[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < size ? base64Chars[chunk & 63] : '=');
+    }
+}
+
+bool DecodeBase64(char const *text, std::vector<unsigned char> &out) {
+    static const Base64Lookup lookup;
+
+    out.clear();
+    uint32_t chunk = 0;
+    int bits = 0;
+    for (char const *c = text; *c && *c != '='; ++c) {
+        if (*c == '\n' || *c == '\r' || *c == ' ') {
+            continue;
+        }
+        signed char value = lookup.values[(unsigned char)*c];
+        if (value < 0) {
+            return false;
+        }
+        chunk = (chunk << 6) | (uint32_t)value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back((unsigned char)(chunk >> bits));
+        }
+    }
+    return true;
+}
+
+// Layout cache file (native endianness):
+//   Header
+//   Record[nodeCount]    indexed by node id, id == -1 for ids without a node
+//   Slot[slotCount]      inputs followed by outputs of each record, from firstSlot on
+struct LayoutCache::Header {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t nodeCount;
+    uint32_t slotCount;
+};
+
+struct LayoutCache::Record {
+    int32_t id;
+    ImVec2 pos;
+    ImVec2 size;
+    uint32_t firstSlot;
+    uint16_t inputCount;
+    uint16_t outputCount;
+    uint32_t reserved;
+};
+
+struct LayoutCache::Slot {
+    int32_t type;
+    ImVec2 offset;      // relative to the node position
+};
+
+namespace {
+
+const char layoutMagic[4] = { 'I', 'M', 'N', 'L' };
+const uint16_t layoutVersion = 1;
+
+} // unnamed namespace
+
+bool LayoutCache::save(char const *path, int nodeCount, std::function<NodeState const*(int)> const &node) {
+    std::vector<Record> records(std::max(nodeCount, 0));
+    std::vector<Slot> slots;
+    for (int i = 0; i < nodeCount; ++i) {
+        Record &record = records[i];
+        record.id = -1;
+        NodeState const *state = node(i);
+        // the slot counts are stored as uint16, larger nodes are left to be measured
+        if (!state || state->inputSlots.size() > 0xFFFF || state->outputSlots.size() > 0xFFFF) {
+            continue;
+        }
+        record.id = i;
+        record.pos = state->pos;
+        record.size = state->size;
+        record.firstSlot = (uint32_t)slots.size();
+        record.inputCount = (uint16_t)state->inputSlots.size();
+        record.outputCount = (uint16_t)state->outputSlots.size();
+        for (SlotState const &slot : state->inputSlots) {
+            slots.push_back(Slot{ slot.type, slot.pos - state->pos });
+        }
+        for (SlotState const &slot : state->outputSlots) {
+            slots.push_back(Slot{ slot.type, slot.pos - state->pos });
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, layoutMagic, 4);
+    header.version = layoutVersion;
+    header.reserved = 0;
+    header.nodeCount = (uint32_t)records.size();
+    header.slotCount = (uint32_t)slots.size();
+
+    std::FILE *file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(&header, sizeof(Header), 1, file) == 1;
+    ok = ok && (records.empty() || std::fwrite(records.data(), sizeof(Record), records.size(), file) == records.size());
+    ok = ok && (slots.empty() || std::fwrite(slots.data(), sizeof(Slot), slots.size(), file) == slots.size());
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+bool LayoutCache::open(char const *path) {
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header)) {
+        close();
+        return false;
+    }
+    fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    mapping = fileMapping ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    mappingSize = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    mappingSize = (size_t)info.st_size;
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+    }
+#endif
+    if (!mapping) {
+        close();
+        return false;
+    }
+
+    Header const *fileHeader = static_cast<Header const*>(mapping);
+    size_t expectedSize = sizeof(Header) + (size_t)fileHeader->nodeCount * sizeof(Record) + (size_t)fileHeader->slotCount * sizeof(Slot);
+    if (std::memcmp(fileHeader->magic, layoutMagic, 4) != 0 || fileHeader->version != layoutVersion || mappingSize < expectedSize) {
+        close();
+        return false;
+    }
+    header = fileHeader;
+    records = reinterpret_cast<Record const*>(header + 1);
+    slots = reinterpret_cast<Slot const*>(records + header->nodeCount);
+    return true;
+}
+
+void LayoutCache::close() {
+#ifdef _WIN32
+    if (mapping) {
+        UnmapViewOfFile(mapping);
+    }
+    if (fileMapping) {
+        CloseHandle(fileMapping);
+    }
+    if (file) {
+        CloseHandle(file);
+    }
+    file = nullptr;
+    fileMapping = nullptr;
+#else
+    if (mapping) {
+        munmap(const_cast<void*>(mapping), mappingSize);
+    }
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+    records = nullptr;
+    slots = nullptr;
+}
+
+int LayoutCache::nodeCount() const {
+    return header ? (int)header->nodeCount : 0;
+}
+
+bool LayoutCache::apply(NodeState &node) const {
+    if (!header || node.id < 0 || node.id >= (int)header->nodeCount) {
+        return false;
+    }
+    Record const &record = records[node.id];
+    if (record.id != node.id || (uint64_t)record.firstSlot + record.inputCount + record.outputCount > header->slotCount) {
+        return false;
+    }
+
+    node.pos = node.posFloat = record.pos;
+    node.size = record.size;
+    node.inputSlots.resize(record.inputCount);
+    node.outputSlots.resize(record.outputCount);
+    Slot const *slot = slots + record.firstSlot;
+    for (SlotState &input : node.inputSlots) {
+        input.type = slot->type;
+        input.pos = node.pos + slot->offset;
+        ++slot;
+    }
+    for (SlotState &output : node.outputSlots) {
+        output.type = slot->type;
+        output.pos = node.pos + slot->offset;
+        ++slot;
+    }
+
+    // measured already: BeginNode skips the node while it is invisible and restores its window
+    // size once it shows up
+    node.forceRedraw = false;
+    node.skip = true;
+    return true;
+}
+
+} // namespace nodes
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "imgui_nodes.hpp"
+#include "imgui_nodes_graph.hpp"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstddef>
+
+namespace nodes {
+
+// Application callbacks used to copy and paste node payloads.
+struct SubgraphHooks {
+    // NodeState of a node id or nullptr. Required for copying.
+    std::function<NodeState const*(int)> node;
+    // Appends the user payload of a node, optional.
+    std::function<void(int, std::vector<unsigned char>&)> saveNode;
+    // Creates a pasted node from its payload. The NodeState already carries the new id, position,
+    // size and slot layout. Required for pasting.
+    std::function<void(NodeState&&, unsigned char const*, size_t)> loadNode;
+};
+
+// Writes the selected nodes with their positions, sizes and slot layouts, the edges between
+// them and the user payloads into a versioned binary blob (replacing the contents of out).
+// Returns the number of copied nodes.
+int CopySubgraph(NodeArea const &area, GraphStore const &graph, SubgraphHooks const &hooks, std::vector<unsigned char> &out);
+
+// Adds the nodes and edges of a CopySubgraph blob to the graph under new ids. The nodes keep their
+// relative placement, the top left corner of their bounds is moved to pos (node area coordinates).
+// The pasted nodes become the selection, newNodes (optional) receives their ids.
+// Returns the number of pasted nodes or -1 if the blob is not valid.
+int PasteSubgraph(NodeArea &area, GraphStore &graph, SubgraphHooks const &hooks, unsigned char const *data, size_t size,
+    ImVec2 pos, std::vector<int> *newNodes = nullptr);
+
+// Base64 for passing blobs through the text clipboard.
+void EncodeBase64(unsigned char const *data, size_t size, std::string &out);
+bool DecodeBase64(char const *text, std::vector<unsigned char> &out);
+
+// Layout cache: a flat file with the position, measured size and slot offsets of every node,
+// indexed by node id. Loading it lets the first frame show the final layout instead of waiting
+// for the node sizes to converge. The file is memory mapped read only, nothing is parsed or
+// copied on open, nodes pick up their cached layout in apply.
+class LayoutCache {
+public:
+    // Writes nodes [0, nodeCount) for which node returns non-null. Nodes with more than 65535
+    // input or output slots are not cached.
+    static bool save(char const *path, int nodeCount, std::function<NodeState const*(int)> const &node);
+
+    LayoutCache() = default;
+    ~LayoutCache() { close(); }
+
+    LayoutCache(LayoutCache const&) = delete;
+    LayoutCache& operator=(LayoutCache const&) = delete;
+
+    bool open(char const *path);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    int nodeCount() const;
+
+    // Copies the cached position, size and slots of node.id into node and marks it as measured:
+    // it is not redrawn until it becomes visible and then starts with its cached size. Returns
+    // false if the node is not in the cache.
+    bool apply(NodeState &node) const;
+
+private:
+    struct Header;
+    struct Record;
+    struct Slot;
+
+    void const *mapping = nullptr;
+    size_t mappingSize = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *fileMapping = nullptr;
+#endif
+    Header const *header = nullptr;
+    Record const *records = nullptr;
+    Slot const *slots = nullptr;
+};
+
+} // namespace nodes
@@ -0,0 +1,106 @@
+#include "imgui_nodes_threads.hpp"
+
+#include <algorithm>
+
+namespace nodes {
+
+ThreadPool::ThreadPool(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+    }
+    queues.reset(new Queue[threadCount + 1]);
+    for (int i = 0; i <= threadCount; ++i) {
+        queues[i].next = 0;
+        queues[i].end = 0;
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&ThreadPool::workerMain, this, i + 1);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grainSize, std::function<void(int, int, int)> const &fn) {
+    if (count <= 0) {
+        return;
+    }
+    grainSize = std::max(1, grainSize);
+    int chunkCount = (count + grainSize - 1) / grainSize;
+    if (threads.empty() || chunkCount == 1) {
+        for (int begin = 0; begin < count; begin += grainSize) {
+            fn(begin, std::min(begin + grainSize, count), 0);
+        }
+        return;
+    }
+
+    // distribute the chunks evenly, every worker starts on its own contiguous run
+    int workers = workerCount();
+    for (int i = 0; i < workers; ++i) {
+        queues[i].next = (int)((long long)chunkCount * i / workers);
+        queues[i].end = (int)((long long)chunkCount * (i + 1) / workers);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grainSize;
+        running = (int)threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return running == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerMain(int worker) {
+    unsigned seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seenGeneration; });
+            if (quit) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) {
+            done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runChunks(int worker) {
+    int workers = workerCount();
+    // own queue first, then steal from the others
+    for (int i = 0; i < workers; ++i) {
+        Queue &queue = queues[(worker + i) % workers];
+        for (;;) {
+            int chunk = queue.next.fetch_add(1);
+            if (chunk >= queue.end) {
+                break;
+            }
+            int begin = chunk * jobGrain;
+            (*job)(begin, std::min(begin + jobGrain, jobCount), worker);
+        }
+    }
+}
+
+} // namespace nodes
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace nodes {
+
+// Small fork/join pool used to spread pure per-item work (edge geometry, draw list copies,
+// layout forces) across cores. The range of a parallelFor is split into chunks which are
+// distributed evenly over the workers up front; a worker running out of chunks steals from
+// the others. The calling thread takes part in the work and parallelFor only returns when
+// all chunks are done.
+class ThreadPool {
+public:
+    // threadCount == 0 uses one thread less than the hardware concurrency (the calling thread
+    // is the remaining worker).
+    explicit ThreadPool(int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    // Number of workers including the calling thread.
+    int workerCount() const { return (int)threads.size() + 1; }
+
+    // Calls fn(begin, end, worker) for consecutive ranges of at most grainSize items covering
+    // [0, count). worker is in [0, workerCount()) and unique among concurrently running calls,
+    // which allows indexing per worker scratch buffers. Must not be called recursively.
+    void parallelFor(int count, int grainSize, std::function<void(int, int, int)> const &fn);
+
+private:
+    struct Queue {
+        std::atomic<int> next;
+        int end;
+    };
+
+    void workerMain(int worker);
+    void runChunks(int worker);
+
+    std::vector<std::thread> threads;
+    std::unique_ptr<Queue[]> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation = 0;
+    int running = 0;
+    bool quit = false;
+
+    std::function<void(int, int, int)> const *job = nullptr;
+    int jobCount = 0;
+    int jobGrain = 1;
+};
+
+} // namespace nodes
@@ -0,0 +1,426 @@
+#include "imgui_nodes_undo.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace nodes {
+
+namespace {
+
+inline ImVec2 operator+(const ImVec2& lhs, const ImVec2& rhs) { return ImVec2(lhs.x + rhs.x, lhs.y + rhs.y); }
+inline ImVec2 operator-(const ImVec2& lhs, const ImVec2& rhs) { return ImVec2(lhs.x - rhs.x, lhs.y - rhs.y); }
+inline ImVec2 operator*(const ImVec2& lhs, const float rhs) { return ImVec2(lhs.x * rhs, lhs.y * rhs); }
+inline bool operator!=(const ImVec2& lhs, const ImVec2& rhs) { return lhs.x != rhs.x || lhs.y != rhs.y; }
+
+struct OpReader {
+    unsigned char const *p;
+
+    template<typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+};
+
+} // unnamed namespace
+
+template<typename T>
+void UndoHistory::put(T const &value) {
+    size_t offset = open.data.size();
+    open.data.resize(offset + sizeof(T));
+    std::memcpy(open.data.data() + offset, &value, sizeof(T));
+}
+
+void UndoHistory::recordNodeAdd(int id) {
+    // the payload is only taken when the addition gets undone
+    put(Op_NodeAdd);
+    put(id);
+    put((int)open.payloads.size());
+    open.payloads.emplace_back();
+    open.payloadBytes.push_back(0);
+}
+
+void UndoHistory::recordNodeRemove(int id) {
+    IM_ASSERT(graph && hooks.takeNode);
+    IM_ASSERT(!graph->isGroup(id));
+    for (int e = graph->firstOutgoing(id); e != -1; e = graph->nextOutgoing(e)) {
+        recordEdgeRemove(e);
+    }
+    for (int e = graph->firstIncoming(id); e != -1; e = graph->nextIncoming(e)) {
+        recordEdgeRemove(e);
+    }
+    size_t payloadBytes = 0;
+    put(Op_NodeRemove);
+    put(id);
+    put((int)open.payloads.size());
+    open.payloads.push_back(hooks.takeNode(id, payloadBytes));
+    open.payloadBytes.push_back(payloadBytes);
+    open.bytes += payloadBytes;
+}
+
+void UndoHistory::recordEdgeAdd(int edge) {
+    IM_ASSERT(graph);
+    put(Op_EdgeAdd);
+    put(edge);
+    put(graph->edge(edge));
+}
+
+void UndoHistory::recordEdgeRemove(int edge) {
+    IM_ASSERT(graph);
+    // edges between two removed nodes or selected edges of removed nodes are only recorded once
+    if (!openRemovedEdges.insert(edge).second) {
+        return;
+    }
+    put(Op_EdgeRemove);
+    put(edge);
+    put(graph->edge(edge));
+}
+
+void UndoHistory::recordRemoveSelected(NodeArea const &area) {
+    IM_ASSERT(graph);
+    std::vector<bool> const &edges = area.state.selectedEdges.selectedItems;
+    for (int i = 0; i < (int)edges.size(); ++i) {
+        if (edges[i] && graph->edgeAlive(i)) {
+            recordEdgeRemove(i);
+        }
+    }
+    std::vector<bool> const &nodes = area.state.selectedNodes.selectedItems;
+    for (int i = 0; i < (int)nodes.size(); ++i) {
+        if (nodes[i] && graph->nodeAlive(i) && !graph->isGroup(i)) { // as GraphStore::removeSelected
+            recordNodeRemove(i);
+        }
+    }
+}
+
+void UndoHistory::recordMove(int const *ids, int count, ImVec2 delta) {
+    if (count <= 0) {
+        return;
+    }
+    put(Op_Move);
+    put(count);
+    put((unsigned char)1);
+    put(delta);
+    for (int i = 0; i < count; ++i) {
+        put(ids[i]);
+    }
+}
+
+void UndoHistory::recordResize(int id, ImVec2 oldSize, ImVec2 newSize) {
+    put(Op_Resize);
+    put(id);
+    put(oldSize);
+    put(newSize);
+}
+
+void UndoHistory::recordSelectionDiff(Op op, std::vector<bool> &last, std::vector<bool> const &current) {
+    if (last == current) {
+        return;
+    }
+    int size = (int)std::max(last.size(), current.size());
+    std::vector<int> added, removed;
+    for (int i = 0; i < size; ++i) {
+        bool was = i < (int)last.size() && last[i];
+        bool is = i < (int)current.size() && current[i];
+        if (was != is) {
+            (is ? added : removed).push_back(i);
+        }
+    }
+    last = current;
+    if (added.empty() && removed.empty()) {
+        return;
+    }
+    put(op);
+    put((int)added.size());
+    put((int)removed.size());
+    for (int id : added) {
+        put(id);
+    }
+    for (int id : removed) {
+        put(id);
+    }
+}
+
+void UndoHistory::update(NodeArea const &area) {
+    NodeArea::Mode mode = area.state.mode;
+
+    if (mode == NodeArea::Mode::DraggingNodes && lastMode != NodeArea::Mode::DraggingNodes && hooks.node) {
+        dragNodes.clear();
+        dragStartPos.clear();
+        std::vector<bool> const &selected = area.state.selectedNodes.selectedItems;
+        for (int i = 0; i < (int)selected.size(); ++i) {
+            NodeState *node = selected[i] ? hooks.node(i) : nullptr;
+            if (node) {
+                dragNodes.push_back(i);
+                dragStartPos.push_back(node->pos);
+            }
+        }
+    } else if (mode != NodeArea::Mode::DraggingNodes && lastMode == NodeArea::Mode::DraggingNodes && hooks.node) {
+        // snapping may move nodes by different amounts, the usual case is one shared delta
+        std::vector<int> ids;
+        std::vector<ImVec2> deltas;
+        bool uniform = true;
+        for (size_t i = 0; i < dragNodes.size(); ++i) {
+            NodeState *node = hooks.node(dragNodes[i]);
+            if (node) {
+                ids.push_back(dragNodes[i]);
+                deltas.push_back(node->pos - dragStartPos[i]);
+                uniform = uniform && !(deltas.back() != deltas.front());
+            }
+        }
+        bool moved = false;
+        for (ImVec2 const &delta : deltas) {
+            moved = moved || delta != ImVec2();
+        }
+        if (moved) {
+            put(Op_Move);
+            put((int)ids.size());
+            put((unsigned char)uniform);
+            put(deltas.front());
+            for (int id : ids) {
+                put(id);
+            }
+            if (!uniform) {
+                for (ImVec2 const &delta : deltas) {
+                    put(delta);
+                }
+            }
+        }
+        dragNodes.clear();
+        dragStartPos.clear();
+    }
+
+    if (mode != NodeArea::Mode::ResizingNode && lastMode == NodeArea::Mode::ResizingNode && hooks.node) {
+        NodeState *node = hooks.node(area.state.resizeNode);
+        if (node && node->size != area.state.resizeStartSize) {
+            recordResize(area.state.resizeNode, area.state.resizeStartSize, node->size);
+        }
+    }
+
+    if (recordSelection) {
+        recordSelectionDiff(Op_SelectNodes, lastSelectedNodes, area.state.selectedNodes.selectedItems);
+        recordSelectionDiff(Op_SelectEdges, lastSelectedEdges, area.state.selectedEdges.selectedItems);
+    }
+
+    lastMode = mode;
+    // dragging an unselected node selects it when the drag starts, the entry stays open until the
+    // drag ends so the selection change and the move are undone together
+    if (mode != NodeArea::Mode::DraggingNodes) {
+        commit();
+    }
+}
+
+void UndoHistory::commit() {
+    openRemovedEdges.clear();
+    if (open.data.empty()) {
+        return;
+    }
+
+    // a new entry discards everything which could have been redone
+    while (entries.size() > position) {
+        bytes -= entries.back().bytes;
+        entries.pop_back();
+    }
+
+    open.data.shrink_to_fit();
+    open.bytes += open.data.size() + sizeof(Entry);
+    bytes += open.bytes;
+    entries.push_back(std::move(open));
+    open = Entry();
+    ++position;
+
+    while (bytes > byteBudget && entries.size() > 1) {
+        bytes -= entries.front().bytes;
+        entries.pop_front();
+        --position;
+    }
+}
+
+bool UndoHistory::undo(NodeArea &area) {
+    if (area.state.mode == NodeArea::Mode::DraggingNodes ||
+        area.state.mode == NodeArea::Mode::ResizingNode) {
+        return false;
+    }
+    commit();
+    if (position == 0) {
+        return false;
+    }
+    --position;
+    apply(area, entries[position], false);
+    return true;
+}
+
+bool UndoHistory::redo(NodeArea &area) {
+    if (area.state.mode == NodeArea::Mode::DraggingNodes ||
+        area.state.mode == NodeArea::Mode::ResizingNode) {
+        return false;
+    }
+    commit();
+    if (position == entries.size()) {
+        return false;
+    }
+    apply(area, entries[position], true);
+    ++position;
+    return true;
+}
+
+void UndoHistory::apply(NodeArea &area, Entry &entry, bool forward) {
+    // find the op boundaries first, undo walks them backwards
+    std::vector<size_t> offsets;
+    OpReader reader = { entry.data.data() };
+    unsigned char const *end = entry.data.data() + entry.data.size();
+    while (reader.p < end) {
+        offsets.push_back(reader.p - entry.data.data());
+        switch (reader.get<Op>()) {
+        case Op_Move: {
+            int count = reader.get<int>();
+            bool uniform = reader.get<unsigned char>() != 0;
+            reader.p += sizeof(ImVec2) + count * sizeof(int) + (uniform ? 0 : count * sizeof(ImVec2));
+            break;
+        }
+        case Op_Resize:
+            reader.p += sizeof(int) + 2 * sizeof(ImVec2);
+            break;
+        case Op_NodeAdd:
+        case Op_NodeRemove:
+            reader.p += 2 * sizeof(int);
+            break;
+        case Op_EdgeAdd:
+        case Op_EdgeRemove:
+            reader.p += sizeof(int) + sizeof(GraphStore::Edge);
+            break;
+        case Op_SelectNodes:
+        case Op_SelectEdges: {
+            int added = reader.get<int>();
+            int removed = reader.get<int>();
+            reader.p += (added + removed) * sizeof(int);
+            break;
+        }
+        }
+    }
+
+    // the graph may have been changed without records (e.g. edges dropped by DrawEdge), stale
+    // ops are skipped
+    auto takeNode = [&](int id, int payload) {
+        if (!graph->nodeAlive(id)) {
+            return;
+        }
+        size_t payloadBytes = 0;
+        entry.payloads[payload] = hooks.takeNode(id, payloadBytes);
+        entry.payloadBytes[payload] = payloadBytes;
+        entry.bytes += payloadBytes;
+        bytes += payloadBytes;
+        area.state.selectedNodes.removeFromSelection(id);
+        area.ForgetNode(id);
+        graph->removeNodeAt(id);
+    };
+    auto restoreNode = [&](int id, int payload) {
+        if (graph->nodeAlive(id) || !entry.payloads[payload]) {
+            return;
+        }
+        graph->insertNodeAt(id);
+        hooks.restoreNode(id, entry.payloads[payload]);
+        entry.payloads[payload].reset();
+        entry.bytes -= entry.payloadBytes[payload];
+        bytes -= entry.payloadBytes[payload];
+        entry.payloadBytes[payload] = 0;
+        if (NodeState *node = hooks.node ? hooks.node(id) : nullptr) {
+            area.Invalidate(*node);
+        }
+    };
+
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        reader.p = entry.data.data() + offsets[forward ? i : offsets.size() - 1 - i];
+        Op op = reader.get<Op>();
+        switch (op) {
+        case Op_Move: {
+            int count = reader.get<int>();
+            bool uniform = reader.get<unsigned char>() != 0;
+            ImVec2 delta = reader.get<ImVec2>();
+            OpReader deltas = { reader.p + count * sizeof(int) };
+            for (int n = 0; n < count; ++n) {
+                NodeState *node = hooks.node(reader.get<int>());
+                ImVec2 nodeDelta = uniform ? delta : deltas.get<ImVec2>();
+                if (node) {
+                    node->pos = node->pos + nodeDelta * (forward ? 1.f : -1.f);
+                    node->posFloat = node->pos;
+                    area.Invalidate(*node);
+                }
+            }
+            break;
+        }
+        case Op_Resize: {
+            NodeState *node = hooks.node(reader.get<int>());
+            ImVec2 oldSize = reader.get<ImVec2>();
+            ImVec2 newSize = reader.get<ImVec2>();
+            if (node) {
+                node->size = forward ? newSize : oldSize;
+                area.Invalidate(*node);
+            }
+            break;
+        }
+        case Op_NodeAdd:
+        case Op_NodeRemove: {
+            int id = reader.get<int>();
+            int payload = reader.get<int>();
+            if ((op == Op_NodeAdd) == forward) {
+                restoreNode(id, payload);
+            } else {
+                takeNode(id, payload);
+            }
+            break;
+        }
+        case Op_EdgeAdd:
+        case Op_EdgeRemove: {
+            int edge = reader.get<int>();
+            GraphStore::Edge desc = reader.get<GraphStore::Edge>();
+            if ((op == Op_EdgeAdd) == forward) {
+                if (!graph->edgeAlive(edge) && graph->nodeAlive(desc.sourceNode) && graph->nodeAlive(desc.sinkNode)) {
+                    graph->insertEdgeAt(edge, desc);
+                }
+            } else if (graph->edgeAlive(edge)) {
+                area.state.selectedEdges.removeFromSelection(edge);
+                graph->removeEdgeAt(edge);
+            }
+            break;
+        }
+        case Op_SelectNodes:
+        case Op_SelectEdges: {
+            // absolute, ops of removed items may have touched the selection already
+            NodeArea::Selection &selection = op == Op_SelectNodes ? area.state.selectedNodes : area.state.selectedEdges;
+            int added = reader.get<int>();
+            int removed = reader.get<int>();
+            for (int n = 0; n < added + removed; ++n) {
+                int id = reader.get<int>();
+                if ((n < added) == forward) {
+                    selection.addToSelection(id);
+                } else {
+                    selection.removeFromSelection(id);
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    area.Invalidate();
+    syncSelection(area);
+}
+
+void UndoHistory::syncSelection(NodeArea const &area) {
+    lastSelectedNodes = area.state.selectedNodes.selectedItems;
+    lastSelectedEdges = area.state.selectedEdges.selectedItems;
+}
+
+void UndoHistory::clear() {
+    entries.clear();
+    position = 0;
+    bytes = 0;
+    open = Entry();
+    openRemovedEdges.clear();
+    dragNodes.clear();
+    dragStartPos.clear();
+}
+
+} // namespace nodes
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "imgui_nodes.hpp"
+#include "imgui_nodes_graph.hpp"
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_set>
+#include <cstddef>
+
+namespace nodes {
+
+// Application callbacks used by UndoHistory to reach the node payloads.
+struct UndoHooks {
+    // NodeState of a node id or nullptr. Required for moves and resizes.
+    std::function<NodeState*(int)> node;
+    // Takes the payload (including its NodeState) out of a node which is about to be removed and
+    // leaves the payload slot empty. bytes receives the approximate size for the byte budget.
+    std::function<std::shared_ptr<void>(int, size_t&)> takeNode;
+    // Puts a payload returned by takeNode back. The graph slot of the node is already revived.
+    std::function<void(int, std::shared_ptr<void> const&)> restoreNode;
+};
+
+// Undo/redo of node area edits, stored as compact deltas instead of graph snapshots.
+//
+// Moves and resizes done with the mouse and selection changes are picked up by update(), one
+// drag results in a single entry however long it took, together with the selection change that
+// started it. Structural edits are done by the application and have to be announced through the
+// record functions: node and edge removals before, additions after they were applied to the
+// graph. Everything recorded during a frame (or a drag) ends up in the same entry.
+// The history is a ring buffer: when the recorded entries exceed byteBudget, the oldest ones
+// are dropped.
+class UndoHistory {
+public:
+    UndoHooks hooks;
+    GraphStore *graph = nullptr;    // required for node and edge records
+    size_t byteBudget = 8u << 20;
+    bool recordSelection = true;
+
+    void recordNodeAdd(int id);
+    // Also records the removal of all edges of the node.
+    void recordNodeRemove(int id);
+    void recordEdgeAdd(int edge);
+    void recordEdgeRemove(int edge);
+    // Records the removal of the selected edges and nodes, call before GraphStore::removeSelected.
+    void recordRemoveSelected(NodeArea const &area);
+    void recordMove(int const *ids, int count, ImVec2 delta);
+    void recordResize(int id, ImVec2 oldSize, ImVec2 newSize);
+
+    // Call once per frame after EndNodeArea, closes the entry of the frame.
+    void update(NodeArea const &area);
+
+    // Typically called for UserAction::Undo/Redo. Return false if there was nothing to apply
+    // or the user is dragging/resizing nodes.
+    bool undo(NodeArea &area);
+    bool redo(NodeArea &area);
+
+    bool canUndo() const { return position > 0 || !open.data.empty(); }
+    bool canRedo() const { return position < entries.size(); }
+    size_t memoryUsage() const { return bytes; }
+    void clear();
+
+private:
+    enum Op : unsigned char {
+        Op_Move,
+        Op_Resize,
+        Op_NodeAdd,
+        Op_NodeRemove,
+        Op_EdgeAdd,
+        Op_EdgeRemove,
+        Op_SelectNodes,
+        Op_SelectEdges
+    };
+
+    // Ops are serialized back to back into data. Node payloads are referenced by index.
+    struct Entry {
+        std::vector<unsigned char> data;
+        std::vector<std::shared_ptr<void>> payloads;
+        std::vector<size_t> payloadBytes;   // as reported by takeNode, 0 while not taken
+        size_t bytes = 0;
+    };
+
+    template<typename T> void put(T const &value);
+    void recordSelectionDiff(Op op, std::vector<bool> &last, std::vector<bool> const &current);
+    void commit();
+    void apply(NodeArea &area, Entry &entry, bool forward);
+    void syncSelection(NodeArea const &area);
+
+    std::deque<Entry> entries;
+    size_t position = 0;            // entries before position are undoable, the others redoable
+    size_t bytes = 0;
+    Entry open;
+    std::unordered_set<int> openRemovedEdges;
+
+    NodeArea::Mode lastMode = NodeArea::Mode::None;
+    std::vector<int> dragNodes;
+    std::vector<ImVec2> dragStartPos;
+    std::vector<bool> lastSelectedNodes;
+    std::vector<bool> lastSelectedEdges;
+};
+
+} // namespace nodes